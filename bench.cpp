@@ -0,0 +1,540 @@
+/* Library benchmarks.
+
+usage: bench [NAME...]
+
+runs all benchmarks if no NAME is given, available benchmarks: delta, frame, typed, loopback, unix, priority, rpc */
+#include <map>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include "delta_codec.hpp"
+#include "frame_kernels.hpp"
+#include "typed_channel.hpp"
+#include "loopback.hpp"
+#include "rpc.hpp"
+#include "echo_server.hpp"
+#include "glib_event_loop.hpp"
+
+using std::map, std::string, std::vector, std::function, std::to_string;
+using std::mt19937, std::uniform_int_distribution;
+using std::chrono::steady_clock, std::chrono::duration, std::chrono::duration_cast, std::chrono::nanoseconds;
+using std::cout, std::endl;
+
+namespace {
+
+//! \return elapsed time in microseconds
+template <typename F>
+double measure_us(F && f) {
+	auto const t0 = steady_clock::now();
+	f();
+	return duration<double, std::micro>{steady_clock::now() - t0}.count();
+}
+
+struct instrument {
+	string symbol;
+	int bid, ask;  // in 1/100
+	int volume;
+};
+
+string price(int value) {
+	string const cents = to_string(value % 100);
+	return to_string(value / 100) + (size(cents) < 2 ? ".0" : ".") + cents;
+}
+
+string to_json(vector<instrument> const & instruments, long long ts) {
+	string json = R"({"ts":)" + to_string(ts) + R"(,"instruments":[)";
+	for (instrument const & i : instruments) {
+		json += R"({"symbol":")" + i.symbol + R"(","bid":)" + price(i.bid) + R"(,"ask":)" + price(i.ask)
+			+ R"(,"volume":)" + to_string(i.volume) + "},";
+	}
+	json.back() = ']';
+	json += "}";
+	return json;
+}
+
+/*! Delta mode benchmark, state document with 200 instruments where only a few of them
+changes each tick (similar to market data feed). */
+void delta_bench() {
+	constexpr size_t instrument_count = 200,
+		tick_count = 2000,
+		changes_per_tick = 5,
+		keyframe_interval = 100;
+
+	mt19937 rng{42};
+	vector<instrument> instruments;
+	for (size_t i = 0; i < instrument_count; ++i) {
+		int const price = 1000 + rng() % 100000;
+		instruments.push_back({"SYM" + to_string(i), price, price + 2, int(rng() % 100000)});
+	}
+
+	// prepare messages first so JSON serialization is not measured
+	vector<string> messages;
+	long long ts = 1700000000000;
+	for (size_t tick = 0; tick < tick_count; ++tick) {
+		for (size_t c = 0; c < changes_per_tick; ++c) {
+			instrument & i = instruments[rng() % instrument_count];
+			i.bid += int(rng() % 21) - 10;
+			i.ask = i.bid + 1 + rng() % 3;
+			i.volume += rng() % 1000;
+		}
+		ts += 1 + rng() % 50;
+		messages.push_back(to_json(instruments, ts));
+	}
+
+	size_t full_bytes = 0, delta_bytes = 0;
+	vector<string> frames(size(messages));
+	double const encode_us = measure_us([&]{
+		for (size_t i = 0; i < size(messages); ++i) {
+			full_bytes += size(messages[i]);
+			if (i % keyframe_interval == 0)
+				frames[i] = messages[i];
+			else
+				websocket::delta_encode(messages[i-1], messages[i], frames[i]);
+			delta_bytes += size(frames[i]) + 1;  // + delta tag
+		}
+	});
+
+	string baseline, reconstructed;
+	bool ok = true;
+	double const decode_us = measure_us([&]{
+		for (size_t i = 0; i < size(frames); ++i) {
+			if (i % keyframe_interval == 0)
+				baseline = frames[i];
+			else {
+				ok &= websocket::delta_decode(baseline, frames[i], reconstructed);
+				swap(baseline, reconstructed);
+			}
+		}
+	});
+	ok &= baseline == messages.back();
+
+	cout << "delta: " << tick_count << " messages (avg " << full_bytes / tick_count << " bytes), "
+		<< "full " << full_bytes << " bytes, delta " << delta_bytes << " bytes ("
+		<< 100.0 * delta_bytes / full_bytes << "%), encode " << encode_us / tick_count << " us/msg, "
+		<< "decode " << decode_us / tick_count << " us/msg" << (ok ? "" : ", RECONSTRUCTION FAILED") << "\n";
+}
+
+/*! Frame kernels (masking, UTF-8 validation) throughput benchmark for 16B to 16MB
+messages and each supported instruction set. */
+void frame_bench() {
+	using websocket::kernel_isa;
+
+	uint8_t const key[4] = {0x12, 0x34, 0x56, 0x78};
+	mt19937 rng{42};
+
+	for (size_t msg_size = 16; msg_size <= (16 << 20); msg_size *= 16) {
+		// JSON like text with some non ASCII characters
+		string text;
+		while (size(text) < msg_size)
+			text += (rng() % 8 == 0) ? R"("name":"žltý kôň",)" : R"("bid":1.0712,"ask":1.0714,)";
+		text.resize(msg_size);
+		while (!websocket::valid_utf8(kernel_isa::scalar, text))  // do not cut multibyte sequence
+			text.pop_back();
+
+		size_t const repeat = std::max(size_t{1}, (64 << 20) / msg_size);  // ~64MB processed
+
+		for (kernel_isa isa : {kernel_isa::scalar, kernel_isa::sse2, kernel_isa::avx2}) {
+			if (!websocket::kernel_isa_supported(isa))
+				continue;
+
+			double const mask_us = measure_us([&]{
+				for (size_t i = 0; i < repeat; ++i)
+					websocket::mask_payload(isa, key, data(text), size(text));
+			});
+
+			bool valid = true;
+			double const utf8_us = measure_us([&]{
+				for (size_t i = 0; i < repeat; ++i)
+					valid &= websocket::valid_utf8(isa, text);
+			});
+
+			double const bytes = double(size(text)) * repeat;
+			cout << "frame: " << size(text) << " bytes, " << to_string(isa) << ", mask "
+				<< bytes / mask_us / 1e3 << " GB/s, utf8 " << bytes / utf8_us / 1e3 << " GB/s"
+				<< (valid ? "" : ", VALIDATION FAILED") << "\n";
+		}
+	}
+}
+
+
+//! Client channel counting received messages.
+struct counting_channel : public websocket::client_channel {
+	size_t received = 0;
+
+private:
+	void on_message(std::string_view msg) override {
+		++received;
+	}
+};
+
+//! Runs loop until `cond` is false, without sleeping.
+template <typename Cond>
+void spin_while(glib_event_loop & loop, Cond && cond) {
+	while (cond())
+		loop.loop_iteration();
+}
+
+//! Measures echo round-trip latency and pipelined throughput for connected `client`.
+void echo_bench(char const * label, glib_event_loop & loop, counting_channel & client) {
+	constexpr size_t round_trip_count = 10'000,
+		burst_count = 100'000;
+
+	for (size_t msg_size : {16, 1024, 65536}) {
+		string const msg(msg_size, 'x');
+
+		// round-trip, one message in flight
+		client.received = 0;
+		double const round_trip_us = measure_us([&]{
+			for (size_t i = 1; i <= round_trip_count; ++i) {
+				client.send(msg);
+				spin_while(loop, [&client, i]{return client.received < i;});
+			}
+		});
+
+		// pipelined, all messages sent at once
+		client.received = 0;
+		double const burst_us = measure_us([&]{
+			for (size_t i = 0; i < burst_count; ++i)
+				client.send(msg);
+			spin_while(loop, [&]{return client.received < burst_count;});
+		});
+
+		cout << label << ": " << msg_size << " bytes, round-trip " << round_trip_us / round_trip_count
+			<< " us, pipelined " << burst_count / (burst_us / 1e6) << " msg/s\n";
+	}
+}
+
+//! Connects `client` with `connect` function and waits for connection.
+template <typename Connect>
+bool wait_connected(glib_event_loop & loop, websocket::client_channel & client, Connect && connect) {
+	bool connected = false;
+	websocket::client_channel::connected_handler handler = [&connected](std::error_code const & ec){
+		connected = true;};
+	connect(std::move(handler));
+	loop.go_while([&connected]{return !connected;}, std::chrono::seconds{3});
+	return connected;
+}
+
+/*! Library per message cost measured over in-process loopback transport (no TCP stack, no
+port), round-trip latency and pipelined throughput with echo server. */
+void loopback_bench() {
+	glib_event_loop loop;
+	echo_server server;
+	counting_channel client;
+
+	if (!wait_connected(loop, client, [&](auto && handler){
+		websocket::connect_loopback(server, client, std::move(handler));})) {
+		cout << "loopback: unable to connect\n";
+		return;
+	}
+
+	echo_bench("loopback", loop, client);
+}
+
+//! Unix domain socket (abstract namespace) compared to loopback TCP.
+void unix_bench() {
+	constexpr int port = 41002;
+	constexpr char const * socket_name = "@websocket_bench";
+
+	glib_event_loop loop;
+	echo_server tcp_server, unix_server;
+	if (!tcp_server.listen(port, "/echo") || !unix_server.listen_unix(socket_name, "/echo")) {
+		cout << "unix: unable to listen\n";
+		return;
+	}
+
+	counting_channel tcp_client;
+	if (!wait_connected(loop, tcp_client, [&](auto && handler){
+		tcp_client.connect("ws://localhost:" + to_string(port) + "/echo", std::move(handler));})) {
+		cout << "unix: unable to connect TCP client\n";
+		return;
+	}
+
+	counting_channel unix_client;
+	if (!wait_connected(loop, unix_client, [&](auto && handler){
+		unix_client.connect_unix(socket_name, "/echo", std::move(handler));})) {
+		cout << "unix: unable to connect Unix socket client\n";
+		return;
+	}
+
+	echo_bench("unix: tcp", loop, tcp_client);
+	echo_bench("unix: uds", loop, unix_client);
+}
+
+struct quote {
+	char symbol[8];
+	double bid, ask;
+};
+
+//! Minimal JSON quote parser, the same parsing work is done on both string and typed path.
+bool from_json(std::string_view json, quote & q) {
+	return sscanf(string{json}.c_str(), R"({"symbol":"%7[^"]","bid":%lf,"ask":%lf})", q.symbol, &q.bid, &q.ask) == 3;
+}
+
+void to_json(quote const & q, string & json) {
+	char buf[128];
+	snprintf(buf, sizeof(buf), R"({"symbol":"%s","bid":%.5f,"ask":%.5f})", q.symbol, q.bid, q.ask);
+	json += buf;
+}
+
+//! String path client, JSON is parsed into temporary inside `on_message(std::string_view)`.
+struct string_quote_channel : public websocket::client_channel {
+	size_t received = 0;
+	double checksum = 0;  // to prevent optimizing decoding away
+
+private:
+	void on_message(std::string_view msg) override {
+		quote q;
+		if (from_json(msg, q))
+			checksum += q.bid + q.ask;
+		++received;
+	}
+};
+
+//! Typed client, quote is decoded by `Codec` into reusable message and dispatched statically.
+template <typename Codec>
+struct typed_quote_channel
+	: public websocket::typed_client_channel<typed_quote_channel<Codec>, quote, Codec> {
+
+	size_t received = 0;
+	double checksum = 0;
+
+	void on_message(quote const & q) {
+		checksum += q.bid + q.ask;
+		++received;
+	}
+};
+
+//! Server sending quotes encoded by `Codec`.
+template <typename Codec>
+struct quote_feed : public websocket::typed_server_channel<quote_feed<Codec>, quote, Codec> {
+	void on_message(quote const &) {}  // nothing is sent by clients
+};
+
+/*! Broadcasts quotes encoded with `Codec` to `Client` over loopback transport.
+\return time per message in nanoseconds or 0 in case of connection failure */
+template <typename Codec, typename Client>
+double typed_round(double & checksum) {
+	constexpr size_t message_count = 200'000,
+		batch_size = 1'000;  // messages in flight
+
+	glib_event_loop loop;
+	quote_feed<Codec> server;
+	Client client;
+
+	if (!wait_connected(loop, client, [&](auto && handler){
+		websocket::connect_loopback(server, client, std::move(handler));})) {
+		cout << "typed: unable to connect\n";
+		return 0;
+	}
+
+	quote q = {"EURUSD", 1.0712, 1.0714};
+	double const us = measure_us([&]{
+		for (size_t sent = 0; sent < message_count;) {
+			for (size_t i = 0; i < batch_size; ++i, ++sent) {
+				q.bid += 1e-5;
+				server.send_all(q);
+			}
+			spin_while(loop, [&client, sent]{return client.received < sent;});
+		}
+	});
+
+	checksum += client.checksum;
+	return 1e3 * us / message_count;
+}
+
+/*! Typed channel receive path compared to string path (JSON message parsed into temporary
+inside `on_message(std::string_view)`) through loopback channel. Both JSON paths use the same
+parser, so the difference is decoding into reusable message and static dispatch. POD codec is
+shown for reference. */
+void typed_bench() {
+	using websocket::json_codec, websocket::pod_codec;
+
+	double checksum = 0;
+	double const string_ns = typed_round<json_codec<quote>, string_quote_channel>(checksum),
+		json_ns = typed_round<json_codec<quote>, typed_quote_channel<json_codec<quote>>>(checksum),
+		pod_ns = typed_round<pod_codec<quote>, typed_quote_channel<pod_codec<quote>>>(checksum);
+
+	cout << "typed: string path (json) " << string_ns << " ns/msg, "
+		<< "json_codec " << json_ns << " ns/msg, "
+		<< "pod_codec " << pod_ns << " ns/msg (checksum " << checksum << ")\n";
+}
+
+//! \return steady clock time point as nanoseconds (heartbeat message timestamp)
+long long timestamp_ns(steady_clock::time_point t) {
+	return duration_cast<nanoseconds>(t.time_since_epoch()).count();
+}
+
+//! Client channel measuring heartbeat latency while receiving bulk messages.
+struct heartbeat_channel : public websocket::client_channel {
+	size_t bulk_received = 0;
+	vector<double> latencies_us;
+
+private:
+	void on_message(std::string_view msg) override {
+		if (msg.substr(0, 3) != "hb ") {
+			++bulk_received;
+			return;
+		}
+
+		long long const sent = std::stoll(string{msg.substr(3)});
+		latencies_us.push_back((timestamp_ns(steady_clock::now()) - sent) / 1e3);
+	}
+};
+
+//! Runs one priority benchmark round, \return heartbeat latencies in microseconds.
+vector<double> priority_round(bool lanes) {
+	constexpr size_t bulk_size = 1 << 20,
+		bulk_in_flight = 4;
+	constexpr std::chrono::milliseconds heartbeat_period{1},
+		round_duration{2000};
+
+	glib_event_loop loop;
+	websocket::server_channel server;
+	heartbeat_channel client;
+
+	if (lanes) {
+		server.enable_priority_lanes();
+		client.enable_priority_lanes();
+	}
+
+	if (!wait_connected(loop, client, [&](auto && handler){
+		websocket::connect_loopback(server, client, std::move(handler));})) {
+		cout << "priority: unable to connect\n";
+		return {};
+	}
+
+	string const snapshot(bulk_size, 's');
+	size_t bulk_sent = 0;
+	auto const start = steady_clock::now();
+	auto next_heartbeat = start;
+
+	while (steady_clock::now() - start < round_duration) {
+		// keep bulk lane saturated
+		while (bulk_sent - client.bulk_received < bulk_in_flight) {
+			server.send_all(snapshot, websocket::priority::bulk);
+			++bulk_sent;
+		}
+
+		auto const now = steady_clock::now();
+		if (now >= next_heartbeat) {
+			server.send_all("hb " + to_string(timestamp_ns(now)), websocket::priority::control);
+			next_heartbeat += heartbeat_period;
+		}
+
+		loop.loop_iteration();
+	}
+
+	return client.latencies_us;
+}
+
+/*! Control message (heartbeat) latency under saturated bulk traffic (1MB snapshots) with and
+without priority lanes. */
+void priority_bench() {
+	for (bool lanes : {false, true}) {
+		vector<double> latencies = priority_round(lanes);
+		if (empty(latencies)) {
+			cout << "priority: no heartbeat received\n";
+			continue;
+		}
+
+		sort(begin(latencies), end(latencies));
+		auto percentile = [&latencies](double p){
+			return latencies[std::min(size(latencies) - 1, size_t(p * size(latencies)))];
+		};
+
+		cout << "priority: lanes " << (lanes ? "on" : "off") << ", " << size(latencies) << " heartbeats, "
+			<< "p50 " << percentile(0.5) << " us, p99 " << percentile(0.99) << " us, p99.9 "
+			<< percentile(0.999) << " us, max " << latencies.back() << " us\n";
+	}
+}
+
+/*! RPC calls per second over loopback transport depending on pipelining depth (number of calls
+in flight), depth 1 is the same as waiting for each response before the next call. */
+void rpc_bench() {
+	using websocket::rpc_status;
+	constexpr size_t call_count = 100'000;
+
+	glib_event_loop loop;
+	websocket::rpc_server_channel server;
+	server.bind("echo", [](std::string_view request, string & response){
+		response = request;
+		return true;
+	});
+
+	websocket::rpc_client_channel client;
+	if (!wait_connected(loop, client, [&](auto && handler){
+		websocket::connect_loopback(server, client, std::move(handler));})) {
+		cout << "rpc: unable to connect\n";
+		return;
+	}
+
+	string const request(64, 'r');
+	for (size_t depth : {1, 4, 16, 64, 256}) {
+		size_t sent = 0,
+			failed = 0;
+
+		// each response issues next call, so there are always `depth` calls in flight
+		function<void (rpc_status, std::string_view)> on_response;
+		auto next_call = [&]{
+			if (sent == call_count)
+				return;
+			++sent;
+			client.call("echo", request, [&on_response](rpc_status status, std::string_view response){
+				on_response(status, response);});
+		};
+
+		on_response = [&](rpc_status status, std::string_view){
+			if (status != rpc_status::ok)
+				++failed;
+			next_call();
+		};
+
+		double const elapsed_us = measure_us([&]{
+			for (size_t i = 0; i < depth; ++i)
+				next_call();
+			spin_while(loop, [&]{return client.pending() > 0;});
+		});
+
+		cout << "rpc: depth " << depth << ", " << call_count / (elapsed_us / 1e6) << " calls/s";
+		if (failed > 0)
+			cout << " (" << failed << " failed)";
+		cout << "\n";
+	}
+}
+
+}  // namespace
+
+int main(int argc, char * argv[]) {
+	map<string, function<void ()>> const benchmarks = {
+		{"delta", delta_bench},
+		{"frame", frame_bench},
+		{"typed", typed_bench},
+		{"loopback", loopback_bench},
+		{"unix", unix_bench},
+		{"priority", priority_bench},
+		{"rpc", rpc_bench}
+	};
+
+	if (argc < 2) {
+		for (auto const & [name, bench] : benchmarks)
+			bench();
+		return 0;
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		auto it = benchmarks.find(argv[i]);
+		if (it == end(benchmarks)) {
+			cout << "unknown benchmark '" << argv[i] << "'" << endl;
+			return 1;
+		}
+		it->second();
+	}
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+#include "delta_codec.hpp"
+
+using std::string_view, std::string, std::vector;
+
+namespace websocket {
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 16;  //!< baseline block size indexed by hash table
+constexpr size_t MIN_PREDICTED_MATCH = 6;  //!< minimal match length at predicted position
+constexpr uint32_t HASH_BASE = 0x01000193;
+
+void put_varint(string & out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back(char(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(char(value));
+}
+
+bool get_varint(string_view & in, uint64_t & value) {
+	value = 0;
+	for (unsigned shift = 0; shift < 64 && !in.empty(); shift += 7) {
+		uint8_t const b = uint8_t(in.front());
+		in.remove_prefix(1);
+		value |= uint64_t(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+void put_literal(string & out, char const * data, size_t size) {
+	if (size == 0)
+		return;
+	put_varint(out, size << 1);
+	out.append(data, size);
+}
+
+void put_copy(string & out, size_t offset, size_t size) {
+	put_varint(out, (size << 1) | 1);
+	put_varint(out, offset);
+}
+
+uint32_t block_hash(char const * p) {
+	uint32_t h = 0;
+	for (size_t i = 0; i < BLOCK_SIZE; ++i)
+		h = h * HASH_BASE + uint8_t(p[i]);
+	return h;
+}
+
+size_t match_length(string_view a, size_t a_pos, string_view b, size_t b_pos) {
+	size_t n = 0;
+	size_t const max_n = std::min(a.size() - a_pos, b.size() - b_pos);
+	while (n < max_n && a[a_pos + n] == b[b_pos + n])
+		++n;
+	return n;
+}
+
+}  // namespace
+
+size_t delta_encode(string_view baseline, string_view target, string & out) {
+	size_t const start_size = out.size();
+	put_varint(out, target.size());
+
+	// index baseline blocks, table stores block offset + 1 (0 for empty slot)
+	size_t const block_count = baseline.size() / BLOCK_SIZE;
+	unsigned bits = 4;
+	while ((size_t{1} << bits) < block_count * 2)
+		++bits;
+
+	vector<uint32_t> table(size_t{1} << bits, 0);
+	auto slot = [bits](uint32_t h){return (h * 2654435761u) >> (32 - bits);};
+
+	for (size_t i = 0; i < block_count; ++i) {
+		uint32_t & s = table[slot(block_hash(baseline.data() + i*BLOCK_SIZE))];
+		if (s == 0)  // keep the first occurrence
+			s = uint32_t(i*BLOCK_SIZE + 1);
+	}
+
+	uint32_t out_factor = 1;  // HASH_BASE^(BLOCK_SIZE-1), to remove leaving byte from rolling hash
+	for (size_t i = 1; i < BLOCK_SIZE; ++i)
+		out_factor *= HASH_BASE;
+
+	size_t literal_begin = 0;
+	size_t i = 0;
+	size_t predicted = 0;  // baseline position corresponding to `i` after the last copy
+	uint32_t h = 0;
+	bool hash_valid = false;
+
+	while (i < target.size()) {
+		size_t match_pos = 0, match_len = 0;
+
+		// 1. same layout as baseline (e.g. changed value with the same length)
+		if (predicted < baseline.size()) {
+			size_t const n = match_length(baseline, predicted, target, i);
+			if (n >= MIN_PREDICTED_MATCH) {
+				match_pos = predicted;
+				match_len = n;
+			}
+		}
+
+		// 2. rolling hash lookup
+		if (match_len == 0 && block_count > 0 && i + BLOCK_SIZE <= target.size()) {
+			if (!hash_valid) {
+				h = block_hash(target.data() + i);
+				hash_valid = true;
+			}
+
+			if (uint32_t const s = table[slot(h)]; s != 0) {
+				size_t const pos = s - 1;
+				if (memcmp(baseline.data() + pos, target.data() + i, BLOCK_SIZE) == 0) {
+					match_pos = pos;
+					match_len = match_length(baseline, pos, target, i);
+				}
+			}
+		}
+
+		if (match_len == 0) {  // no match, extend literal
+			if (hash_valid) {
+				if (i + BLOCK_SIZE < target.size())  // roll
+					h = (h - uint8_t(target[i]) * out_factor) * HASH_BASE + uint8_t(target[i + BLOCK_SIZE]);
+				else
+					hash_valid = false;
+			}
+			++i;
+			++predicted;
+			continue;
+		}
+
+		// extend match backward into pending literal
+		while (i > literal_begin && match_pos > 0 && baseline[match_pos-1] == target[i-1]) {
+			--i;
+			--match_pos;
+			++match_len;
+		}
+
+		put_literal(out, target.data() + literal_begin, i - literal_begin);
+		put_copy(out, match_pos, match_len);
+
+		i += match_len;
+		literal_begin = i;
+		predicted = match_pos + match_len;
+		hash_valid = false;
+	}
+
+	put_literal(out, target.data() + literal_begin, target.size() - literal_begin);
+	return out.size() - start_size;
+}
+
+bool delta_decode(string_view baseline, string_view delta, string & out) {
+	uint64_t target_size = 0;
+	if (!get_varint(delta, target_size))
+		return false;
+
+	out.clear();
+	out.reserve(std::min<uint64_t>(target_size, baseline.size() + delta.size()));  // target size is not trusted
+
+	while (!delta.empty()) {
+		uint64_t op = 0;
+		if (!get_varint(delta, op))
+			return false;
+
+		uint64_t const size = op >> 1;
+		if (op & 1) {  // copy
+			uint64_t offset = 0;
+			if (!get_varint(delta, offset) || offset > baseline.size() || size > baseline.size() - offset)
+				return false;
+			out.append(baseline.data() + offset, size);
+		}
+		else {  // literal
+			if (size > delta.size())
+				return false;
+			out.append(delta.data(), size);
+			delta.remove_prefix(size);
+		}
+
+		if (out.size() > target_size)
+			return false;
+	}
+
+	return out.size() == target_size;
+}
+
+}  // websocket
@@ -0,0 +1,30 @@
+/*! \file
+Binary delta encoding used by channel delta mode. */
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace websocket {
+
+/*! Delta mode binary message tags (first byte of a binary message). Tag is followed by one byte
+stream key size, stream key (empty for default stream) and keyframe or delta payload. */
+enum class delta_tag : uint8_t {
+	keyframe = 0x01,  //!< full message follows
+	delta = 0x02  //!< delta against the previous message follows
+};
+
+/*! Appends delta of `target` against `baseline` to `out`.
+
+Delta is a varint encoded target size followed by a sequence of copy (offset and length in
+`baseline`) and literal (length and bytes) operations. Matches are found with rolling hash over
+baseline blocks, so inserted or removed bytes (e.g. number with more digits in JSON document)
+do not invalidate the rest of the message.
+\return number of bytes appended */
+size_t delta_encode(std::string_view baseline, std::string_view target, std::string & out);
+
+/*! Reconstructs message from `baseline` and `delta` into `out` (`out` content is replaced).
+\return false in case of malformed delta */
+bool delta_decode(std::string_view baseline, std::string_view delta, std::string & out);
+
+}  // websocket
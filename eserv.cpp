@@ -1,9 +1,14 @@
 // WebSocket echo server sample, open websocket.html in a browser window to send/receive message
+// usage: eserv [LOG], where LOG is optional traffic log file (see wsreplay)
+#include <memory>
 #include <iostream>
 #include "echo_server.hpp"
+#include "traffic_recorder.hpp"
 #include "glib_event_loop.hpp"
 
 using std::cout, std::endl;
+using std::unique_ptr, std::make_unique;
+using namespace std::chrono_literals;
 
 constexpr size_t PORT = 41001;
 constexpr char const * PATH = "/test";
@@ -12,11 +17,25 @@ int main(int argc, char * argv[]) {
 	glib_event_loop loop;
 
 	echo_server serv;
-	if (!serv.listen(PORT, PATH))
+	if (!serv.listen(PORT, PATH, true))  // with SO_REUSEPORT so new instance can start while this one is draining
 		return 1;  // can not listen, exit
 
+	// drain connections before quit
+	loop.set_interrupt_handler([&serv, &loop]{
+		serv.drain(5s, [&loop]{loop.quit();});
+	});
+
+	unique_ptr<websocket::traffic_recorder> rec;
+	if (argc > 1) {
+		rec = make_unique<websocket::traffic_recorder>(argv[1]);
+		if (!rec->is_open())
+			return 1;
+		serv.set_recorder(rec.get());
+		cout << "recording traffic to " << argv[1] << "\n";
+	}
+
 	cout << "listenning on ws://localhost:" << PORT << PATH << " WebSocket address\n"
-		<< "press ctrl+c to quit" << endl;
+		<< "press ctrl+c to drain and quit (twice to quit immediately)" << endl;
 
 	loop.go();  // blocking
 	return 0;
@@ -0,0 +1,235 @@
+#include <cassert>
+#include "frame_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define X86_KERNELS
+	#include <immintrin.h>
+#endif
+
+using std::string_view;
+
+namespace websocket {
+
+namespace {
+
+void mask_scalar(uint8_t const key[4], uint8_t * data, size_t size, size_t key_offset) {
+	for (size_t i = 0; i < size; ++i)
+		data[i] ^= key[(key_offset + i) & 3];
+}
+
+#ifdef X86_KERNELS
+//! \return rotated mask key word so byte `i` of the word masks payload byte `key_offset + i`
+uint32_t key_word(uint8_t const key[4], size_t key_offset) {
+	uint8_t rotated[4];
+	for (size_t i = 0; i < 4; ++i)
+		rotated[i] = key[(key_offset + i) & 3];
+
+	uint32_t word;
+	__builtin_memcpy(&word, rotated, 4);
+	return word;
+}
+
+__attribute__((target("sse2")))
+void mask_sse2(uint8_t const key[4], uint8_t * data, size_t size, size_t key_offset) {
+	__m128i const k = _mm_set1_epi32(int(key_word(key, key_offset)));
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {  // 16 is multiple of 4 so key phase doesn't change
+		__m128i * p = reinterpret_cast<__m128i *>(data + i);
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), k));
+	}
+
+	mask_scalar(key, data + i, size - i, key_offset + i);
+}
+
+__attribute__((target("avx2")))
+void mask_avx2(uint8_t const key[4], uint8_t * data, size_t size, size_t key_offset) {
+	__m256i const k = _mm256_set1_epi32(int(key_word(key, key_offset)));
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i * p = reinterpret_cast<__m256i *>(data + i);
+		_mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), k));
+	}
+
+	mask_scalar(key, data + i, size - i, key_offset + i);
+}
+#endif  // X86_KERNELS
+
+/*! Validates one UTF-8 sequence starting at `pos`.
+\return position after the sequence or 0 in case of invalid sequence */
+size_t utf8_sequence(uint8_t const * s, size_t size, size_t pos) {
+	uint8_t const c = s[pos];
+	if (c < 0x80)
+		return pos + 1;
+
+	size_t len;
+	uint8_t lo = 0x80, hi = 0xbf;  // valid range of the second byte
+	if (c >= 0xc2 && c <= 0xdf)
+		len = 2;
+	else if (c >= 0xe0 && c <= 0xef) {
+		len = 3;
+		if (c == 0xe0)
+			lo = 0xa0;  // overlong
+		else if (c == 0xed)
+			hi = 0x9f;  // surrogates
+	}
+	else if (c >= 0xf0 && c <= 0xf4) {
+		len = 4;
+		if (c == 0xf0)
+			lo = 0x90;  // overlong
+		else if (c == 0xf4)
+			hi = 0x8f;  // above U+10FFFF
+	}
+	else
+		return 0;
+
+	if (pos + len > size || s[pos+1] < lo || s[pos+1] > hi)
+		return 0;
+
+	for (size_t i = 2; i < len; ++i)
+		if ((s[pos+i] & 0xc0) != 0x80)
+			return 0;
+
+	return pos + len;
+}
+
+bool valid_utf8_scalar(uint8_t const * s, size_t size) {
+	for (size_t pos = 0; pos < size;) {
+		// ASCII fast path, 8 bytes at once
+		if (pos + 8 <= size) {
+			uint64_t word;
+			__builtin_memcpy(&word, s + pos, 8);
+			if (!(word & 0x8080808080808080ull)) {
+				pos += 8;
+				continue;
+			}
+		}
+
+		pos = utf8_sequence(s, size, pos);
+		if (pos == 0)
+			return false;
+	}
+	return true;
+}
+
+#ifdef X86_KERNELS
+/* SIMD validation skips ASCII bytes (common case for JSON payloads) block by block and validates
+the first non ASCII sequence found in a block with scalar code, `pos` is always at sequence boundary. */
+
+__attribute__((target("sse2")))
+bool valid_utf8_sse2(uint8_t const * s, size_t size) {
+	size_t pos = 0;
+	while (pos + 16 <= size) {
+		__m128i const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(s + pos));
+		unsigned const non_ascii = unsigned(_mm_movemask_epi8(block));
+		if (non_ascii == 0) {
+			pos += 16;
+			continue;
+		}
+
+		pos = utf8_sequence(s, size, pos + __builtin_ctz(non_ascii));  // skip ASCII prefix
+		if (pos == 0)
+			return false;
+	}
+
+	for (; pos < size;) {
+		pos = utf8_sequence(s, size, pos);
+		if (pos == 0)
+			return false;
+	}
+	return true;
+}
+
+__attribute__((target("avx2")))
+bool valid_utf8_avx2(uint8_t const * s, size_t size) {
+	size_t pos = 0;
+	while (pos + 32 <= size) {
+		__m256i const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(s + pos));
+		unsigned const non_ascii = unsigned(_mm256_movemask_epi8(block));
+		if (non_ascii == 0) {
+			pos += 32;
+			continue;
+		}
+
+		pos = utf8_sequence(s, size, pos + __builtin_ctz(non_ascii));  // skip ASCII prefix
+		if (pos == 0)
+			return false;
+	}
+
+	for (; pos < size;) {
+		pos = utf8_sequence(s, size, pos);
+		if (pos == 0)
+			return false;
+	}
+	return true;
+}
+
+#endif  // X86_KERNELS
+
+kernel_isa detect_isa() {
+#ifdef X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return kernel_isa::avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		return kernel_isa::sse2;
+#endif
+	return kernel_isa::scalar;
+}
+
+}  // namespace
+
+kernel_isa best_kernel_isa() {
+	static kernel_isa const isa = detect_isa();
+	return isa;
+}
+
+bool kernel_isa_supported(kernel_isa isa) {
+	return isa <= best_kernel_isa();
+}
+
+char const * to_string(kernel_isa isa) {
+	switch (isa) {
+		case kernel_isa::scalar: return "scalar";
+		case kernel_isa::sse2: return "sse2";
+		case kernel_isa::avx2: return "avx2";
+		default:
+			assert(0);
+			return "unknown";
+	}
+}
+
+void mask_payload(uint8_t const key[4], char * data, size_t size, size_t key_offset) {
+	mask_payload(best_kernel_isa(), key, data, size, key_offset);
+}
+
+void mask_payload(kernel_isa isa, uint8_t const key[4], char * data, size_t size, size_t key_offset) {
+	assert(kernel_isa_supported(isa));
+	uint8_t * p = reinterpret_cast<uint8_t *>(data);
+	switch (isa) {
+#ifdef X86_KERNELS
+		case kernel_isa::avx2: mask_avx2(key, p, size, key_offset); return;
+		case kernel_isa::sse2: mask_sse2(key, p, size, key_offset); return;
+#endif
+		default: mask_scalar(key, p, size, key_offset); return;
+	}
+}
+
+bool valid_utf8(string_view text) {
+	return valid_utf8(best_kernel_isa(), text);
+}
+
+bool valid_utf8(kernel_isa isa, string_view text) {
+	assert(kernel_isa_supported(isa));
+	uint8_t const * s = reinterpret_cast<uint8_t const *>(text.data());
+	switch (isa) {
+#ifdef X86_KERNELS
+		case kernel_isa::avx2: return valid_utf8_avx2(s, text.size());
+		case kernel_isa::sse2: return valid_utf8_sse2(s, text.size());
+#endif
+		default: return valid_utf8_scalar(s, text.size());
+	}
+}
+
+}  // websocket
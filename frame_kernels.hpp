@@ -0,0 +1,35 @@
+/*! \file
+WebSocket frame processing kernels (payload masking and UTF-8 validation) with SSE2/AVX2
+implementations selected at runtime.
+
+\note WebSocket frames are parsed, unmasked and validated by libsoup, these kernels are not
+used there. Channels use them only for text reconstructed in delta mode, so they do not speed
+up server ingest. */
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace websocket {
+
+//! Kernel instruction set.
+enum class kernel_isa {
+	scalar,
+	sse2,
+	avx2
+};
+
+kernel_isa best_kernel_isa();  //!< \return the best instruction set supported by CPU (detected once)
+bool kernel_isa_supported(kernel_isa isa);
+char const * to_string(kernel_isa isa);
+
+/*! XORs `data` with 4 bytes masking `key` in place (the same operation masks and unmasks payload).
+\param[in] key_offset payload offset of `data` in case payload is processed in pieces */
+void mask_payload(uint8_t const key[4], char * data, size_t size, size_t key_offset = 0);
+void mask_payload(kernel_isa isa, uint8_t const key[4], char * data, size_t size, size_t key_offset = 0);
+
+//! \return true if `text` is valid UTF-8 (overlong forms, surrogates and code points above U+10FFFF are rejected)
+bool valid_utf8(std::string_view text);
+bool valid_utf8(kernel_isa isa, std::string_view text);
+
+}  // websocket
@@ -1,21 +1,12 @@
 #include <thread>
+#include <algorithm>
 #include <cassert>
 #include <libsoup/soup.h>
 #include <glib-unix.h>
 #include "glib_event_loop.hpp"
 #include <iostream>
 
-using std::chrono::milliseconds, std::cout;
-
-namespace {
-
-gboolean quit_loop(glib_event_loop * loop) {
-	cout << "ctrl+c (SIGINT) signal catched\n";
-	loop->quit();
-	return TRUE;
-}
-
-}  // namespace
+using std::chrono::milliseconds, std::chrono::steady_clock, std::cout;
 
 
 glib_event_loop::glib_event_loop()
@@ -54,15 +45,21 @@ bool glib_event_loop::go_while(std::function<bool (void)> cond, std::chrono::mil
 	g_assert(g_main_context_is_owner(_ctx));
 
 	// used for testing purpose it doesn't need to be exact
-	milliseconds remains = timeout;
+	steady_clock::time_point const deadline = steady_clock::now() + timeout;
+
+	while (cond()) {
+		if (steady_clock::now() >= deadline)
+			return false;
 
-	while (cond() && remains > milliseconds{0}) {
-		g_main_context_iteration(_ctx, FALSE);
-		std::this_thread::sleep_for(milliseconds{10});
-		remains -= milliseconds{10};
+		// dispatch all ready events before sleep, sources which are always ready can not hold us past the deadline
+		while (cond() && steady_clock::now() < deadline && g_main_context_iteration(_ctx, FALSE)) {}
+
+		if (cond())
+			std::this_thread::sleep_for(std::min<steady_clock::duration>(milliseconds{10},
+				deadline - steady_clock::now()));
 	}
 
-	return remains >= milliseconds{0} ? true : false;
+	return true;
 }
 
 void glib_event_loop::loop_iteration() {
@@ -73,9 +70,30 @@ void glib_event_loop:: quit() {
 	g_main_loop_quit(_loop);
 }
 
+void glib_event_loop::set_interrupt_handler(interrupt_handler && handler) {
+	_interrupt_handler = move(handler);
+}
+
 void glib_event_loop::install_interrupt_handler() {
 	assert(!_sigint && "signal already installed");
 	_sigint = g_unix_signal_source_new(SIGINT);
-	g_source_set_callback(_sigint, (GSourceFunc)quit_loop, this, nullptr);
+	g_source_set_callback(_sigint, interrupt_cb, this, nullptr);
 	g_source_attach(_sigint, _ctx);
 }
+
+gboolean glib_event_loop::interrupt_cb(gpointer user_data) {
+	glib_event_loop * loop = static_cast<glib_event_loop *>(user_data);
+	assert(loop);
+
+	cout << "ctrl+c (SIGINT) signal catched\n";
+
+	if (loop->_interrupt_handler) {
+		interrupt_handler handler = move(loop->_interrupt_handler);
+		loop->_interrupt_handler = nullptr;  // next ctrl+c quits loop
+		handler();
+	}
+	else
+		loop->quit();
+
+	return TRUE;
+}
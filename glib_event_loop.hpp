@@ -7,18 +7,26 @@
 \note the context is set as default to this thread so `event_loop` instance needs to be created at the very beginning of thread main (before any other GLib object using context). */
 class glib_event_loop {
 public:
+	using interrupt_handler = std::function<void ()>;
+
 	glib_event_loop();
 	~glib_event_loop();
 	void go();  //!< \note blocking
 	void go_for(std::chrono::milliseconds const & dur);
-	bool go_while(std::function<bool (void)> cond, std::chrono::milliseconds const & timeout);
+	bool go_while(std::function<bool (void)> cond, std::chrono::milliseconds const & timeout);  //!< \return false if `timeout` expired while `cond` was still true
 	void loop_iteration();
 	void quit();
 
+	/*! Replaces default `<ctrl+c>` (SIGINT) behaviour (quit loop), e.g. to drain server first.
+	\note second `<ctrl+c>` quits loop immediately */
+	void set_interrupt_handler(interrupt_handler && handler);
+
 private:
 	void install_interrupt_handler();  //!< Install `<ctr+c>` (SIGINT) interrupt handler.
+	static gboolean interrupt_cb(gpointer user_data);
 
 	GMainContext * _ctx;
 	GMainLoop * _loop;
 	GSource * _sigint;
+	interrupt_handler _interrupt_handler;
 };
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cassert>
+#include "last_value_cache.hpp"
+
+using std::string_view, std::string;
+
+namespace websocket {
+
+last_value_cache::last_value_cache(size_t max_bytes)
+	: _max_bytes{max_bytes}
+	, _bytes{0}
+	, _stamp{0}
+{}
+
+void last_value_cache::update(string_view key, string_view value) {
+	if (key.size() + value.size() > _max_bytes) {  // would never fit
+		erase(key);  // previous value is not the last value anymore
+		return;
+	}
+
+	auto it = lower_bound(key);
+	if (it != end(_entries) && it->key == key) {  // update
+		_bytes = _bytes - it->value.size() + value.size();
+		it->value.assign(value.data(), value.size());
+		it->stamp = ++_stamp;
+	}
+	else {  // insert
+		_entries.insert(it, entry{string{key}, string{value}, ++_stamp});
+		_bytes += key.size() + value.size();
+	}
+
+	evict();
+}
+
+void last_value_cache::erase(string_view key) {
+	auto it = lower_bound(key);
+	if (it == end(_entries) || it->key != key)
+		return;
+
+	_bytes -= it->key.size() + it->value.size();
+	_entries.erase(it);
+}
+
+void last_value_cache::clear() {
+	_entries.clear();
+	_bytes = 0;
+}
+
+string_view last_value_cache::find(string_view key) const {
+	auto it = lower_bound(key);
+	return (it != end(_entries) && it->key == key) ? string_view{it->value} : string_view{};
+}
+
+size_t last_value_cache::size() const {
+	return _entries.size();
+}
+
+size_t last_value_cache::bytes() const {
+	return _bytes;
+}
+
+std::vector<last_value_cache::entry>::iterator last_value_cache::lower_bound(string_view key) {
+	return std::lower_bound(begin(_entries), end(_entries), key,
+		[](entry const & e, string_view key){return e.key < key;});
+}
+
+std::vector<last_value_cache::entry>::const_iterator last_value_cache::lower_bound(string_view key) const {
+	return std::lower_bound(begin(_entries), end(_entries), key,
+		[](entry const & e, string_view key){return e.key < key;});
+}
+
+void last_value_cache::evict() {
+	while (_bytes > _max_bytes) {
+		assert(!_entries.empty());
+		auto oldest = std::min_element(begin(_entries), end(_entries),
+			[](entry const & a, entry const & b){return a.stamp < b.stamp;});
+		_bytes -= oldest->key.size() + oldest->value.size();
+		_entries.erase(oldest);
+	}
+}
+
+}  // websocket
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace websocket {
+
+/*! Bounded key to last value map used for snapshot on subscribe feature.
+Entries are stored in key sorted vector (binary search lookup, values stored next to keys) and
+the least recently updated entries are evicted when cache exceeds `max_bytes` (keys + values).
+
+Value update of an existing key costs O(log n), but inserting a new key is O(n) (vector insert)
+and each eviction is O(n) scan for the oldest entry. That is fine for thousands of keys (e.g.
+instruments of one venue), much larger key sets would need an update ordered index.
+\see server_channel::enable_snapshot() */
+class last_value_cache {
+public:
+	explicit last_value_cache(size_t max_bytes);
+	void update(std::string_view key, std::string_view value);  //!< value larger than `max_bytes` is not cached (previous value of `key` is erased)
+	void erase(std::string_view key);
+	void clear();
+	std::string_view find(std::string_view key) const;  //!< \return value or empty view if key not found
+	size_t size() const;  //!< \return number of entries
+	size_t bytes() const;  //!< \return number of key and value bytes stored
+
+	//! Calls `f(key, value)` for each entry in key order.
+	template <typename F>
+	void for_each(F && f) const {
+		for (entry const & e : _entries)
+			f(std::string_view{e.key}, std::string_view{e.value});
+	}
+
+private:
+	struct entry {
+		std::string key;
+		std::string value;
+		uint64_t stamp;  //!< update order
+	};
+
+	std::vector<entry>::iterator lower_bound(std::string_view key);
+	std::vector<entry>::const_iterator lower_bound(std::string_view key) const;
+	void evict();
+
+	std::vector<entry> _entries;  //!< sorted by key
+	size_t const _max_bytes;
+	size_t _bytes;
+	uint64_t _stamp;
+};
+
+}  // websocket
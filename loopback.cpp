@@ -0,0 +1,65 @@
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "loopback.hpp"
+
+using std::cout;
+
+namespace websocket {
+
+namespace {
+
+//! \return stream for socket `fd` (stream owns socket) or nullptr
+GIOStream * socket_stream(int fd) {
+	GError * error = nullptr;
+	GSocket * sock = g_socket_new_from_fd(fd, &error);
+	if (error) {
+		cout << "websocket: unable to create loopback socket, what: " << error->message << "\n";
+		g_error_free(error);
+		return nullptr;
+	}
+
+	GSocketConnection * conn = g_socket_connection_factory_create_connection(sock);
+	g_object_unref(sock);  // connection keeps its own reference
+	return G_IO_STREAM(conn);
+}
+
+}  // namespace
+
+bool connect_loopback(server_channel & server, client_channel & client,
+	client_channel::connected_handler && handler) {
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0, fds) == -1) {
+		cout << "websocket: unable to create loopback socket pair, what: " << strerror(errno) << "\n";
+		return false;
+	}
+
+	GIOStream * server_stream = socket_stream(fds[0]);
+	GIOStream * client_stream = socket_stream(fds[1]);
+	if (!server_stream || !client_stream) {
+		if (server_stream)
+			g_object_unref(server_stream);
+		else
+			close(fds[0]);
+
+		if (client_stream)
+			g_object_unref(client_stream);
+		else
+			close(fds[1]);
+
+		return false;
+	}
+
+	// WebSocket connections keep their own stream references
+	server.accept(server_stream);
+	client.connect(client_stream, move(handler));
+
+	g_object_unref(server_stream);
+	g_object_unref(client_stream);
+	return true;
+}
+
+}  // websocket
@@ -0,0 +1,23 @@
+/*! \file
+In-process loopback transport for testing and benchmarking. */
+#pragma once
+#include "websocket.hpp"
+
+namespace websocket {
+
+/*! Connects `client` directly to `server` through socket pair (no TCP listener, no port and
+no HTTP handshake), messages are still WebSocket framed. Server doesn't need to listen.
+
+\code
+glib_event_loop loop;
+echo_server server;
+channel_receiver_sync client;
+connect_loopback(server, client, [&client](std::error_code const & ec){
+	client.send("hello!");
+});
+\endcode
+\return false in case socket pair can not be created */
+bool connect_loopback(server_channel & server, client_channel & client,
+	client_channel::connected_handler && handler);
+
+}  // websocket
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include "priority_lanes.hpp"
+
+using std::string_view, std::cout;
+
+namespace websocket {
+
+namespace detail {
+
+namespace {
+
+constexpr size_t FRAGMENT_HEADER_SIZE = 3;
+
+}  // namespace
+
+outbound_lanes::outbound_lanes(SoupWebsocketConnection * connection, size_t fragment_size)
+	: _conn{connection}
+	, _fragment_size{fragment_size}
+	, _writable{nullptr}
+{
+	assert(_conn && _fragment_size > 0);
+}
+
+outbound_lanes::~outbound_lanes() {
+	if (_writable) {
+		g_source_destroy(_writable);
+		g_source_unref(_writable);
+	}
+}
+
+void outbound_lanes::push(priority prio, message_data data, SoupWebsocketDataType type) {
+	_lanes[size_t(prio)].push_back(message{move(data), type, 0});
+	pump();
+}
+
+void outbound_lanes::pump() {
+	if (_writable)  // already waiting for connection to be writable
+		return;
+
+	while (!empty()) {
+		if (soup_websocket_connection_get_state(_conn) != SOUP_WEBSOCKET_STATE_OPEN) {
+			for (auto & lane : _lanes)  // nobody to send to
+				lane.clear();
+			return;
+		}
+
+		if (!output_flushed(_conn)) {
+			wait_writable();
+			return;
+		}
+
+		send_next();
+	}
+}
+
+bool outbound_lanes::empty() const {
+	for (auto const & lane : _lanes)
+		if (!lane.empty())
+			return false;
+	return true;
+}
+
+void outbound_lanes::send_next() {
+	size_t prio = 0;
+	while (_lanes[prio].empty())
+		++prio;
+
+	auto & lane = _lanes[prio];
+	message & msg = lane.front();
+	string_view const data = *msg.data;
+
+	// small text message as it is
+	if (msg.type == SOUP_WEBSOCKET_DATA_TEXT && msg.offset == 0 && size(data) <= _fragment_size) {
+		soup_websocket_connection_send_text(_conn, msg.data->c_str());
+		lane.pop_front();
+		return;
+	}
+
+	size_t const fragment_size = std::min(_fragment_size, size(data) - msg.offset);
+	bool const last = msg.offset + fragment_size == size(data);
+
+	_frame.resize(FRAGMENT_HEADER_SIZE);
+	_frame[0] = char(last ? lane_tag::last_fragment : lane_tag::fragment);
+	_frame[1] = char(prio);
+	_frame[2] = char(msg.type);
+	_frame.append(data.data() + msg.offset, fragment_size);
+	soup_websocket_connection_send_binary(_conn, _frame.data(), size(_frame));
+
+	msg.offset += fragment_size;
+	if (last)
+		lane.pop_front();
+}
+
+void outbound_lanes::wait_writable() {
+	assert(!_writable);
+
+	GOutputStream * out = g_io_stream_get_output_stream(soup_websocket_connection_get_io_stream(_conn));
+	if (!G_IS_POLLABLE_OUTPUT_STREAM(out))
+		return;
+
+	// lower priority than libsoup's own writer, so it is dispatched after libsoup flushes its queue
+	_writable = g_pollable_output_stream_create_source(G_POLLABLE_OUTPUT_STREAM(out), nullptr);
+	g_source_set_priority(_writable, G_PRIORITY_LOW);
+	g_source_set_callback(_writable, G_SOURCE_FUNC(writable_cb), this, nullptr);
+	g_source_attach(_writable, g_main_context_get_thread_default());
+}
+
+gboolean outbound_lanes::writable_cb(GObject *, gpointer user_data) {
+	outbound_lanes * lanes = static_cast<outbound_lanes *>(user_data);
+	assert(lanes);
+
+	g_source_unref(lanes->_writable);  // source is destroyed after we return G_SOURCE_REMOVE
+	lanes->_writable = nullptr;
+	lanes->pump();
+	return G_SOURCE_REMOVE;
+}
+
+
+lane_reassembler::lane_reassembler()
+	: _delivered{-1}
+{}
+
+bool lane_reassembler::feed(string_view fragment, SoupWebsocketDataType & type, string_view & payload) {
+	if (_delivered != -1) {
+		_partial[_delivered].clear();  // capacity is reused
+		_delivered = -1;
+	}
+
+	if (size(fragment) < FRAGMENT_HEADER_SIZE
+		|| (lane_tag(fragment[0]) != lane_tag::fragment && lane_tag(fragment[0]) != lane_tag::last_fragment)
+		|| uint8_t(fragment[1]) >= size(_partial)) {
+		cout << "websocket: malformed message fragment received, ignored\n";
+		return false;
+	}
+
+	bool const last = lane_tag(fragment[0]) == lane_tag::last_fragment;
+	size_t const lane = uint8_t(fragment[1]);
+	type = SoupWebsocketDataType(fragment[2]);
+	fragment.remove_prefix(FRAGMENT_HEADER_SIZE);
+
+	std::string & partial = _partial[lane];
+	if (last && partial.empty()) {  // single fragment message, no copy
+		payload = fragment;
+		return true;
+	}
+
+	partial.append(fragment.data(), fragment.size());
+	if (!last)
+		return false;
+
+	payload = partial;
+	_delivered = int(lane);
+	return true;
+}
+
+/* libsoup 2.4 doesn't expose send queue size, libsoup writes queued frames from default
+priority source when stream is writable, so stream which is writable when checked from lower
+priority source has the queue flushed. */
+bool output_flushed(SoupWebsocketConnection * conn) {
+	GOutputStream * out = g_io_stream_get_output_stream(soup_websocket_connection_get_io_stream(conn));
+	return !G_IS_POLLABLE_OUTPUT_STREAM(out)
+		|| g_pollable_output_stream_is_writable(G_POLLABLE_OUTPUT_STREAM(out));
+}
+
+}  // detail
+
+}  // websocket
@@ -0,0 +1,87 @@
+/*! \file
+Outbound message priority lanes, small control messages are not waiting behind large bulk
+messages in connection's send queue. */
+#pragma once
+#include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <boost/noncopyable.hpp>
+#include <libsoup/soup.h>
+
+namespace websocket {
+
+//! Outbound message priority class.
+enum class priority : uint8_t {
+	control,  //!< highest priority e.g. cancels, heartbeats, alerts
+	normal,
+	bulk  //!< e.g. large snapshots
+};
+
+//! Priority lanes fragment binary message tags (first byte of a binary message).
+enum class lane_tag : uint8_t {
+	fragment = 0x10,  //!< more fragments of the message follows
+	last_fragment = 0x11
+};
+
+namespace detail {
+
+/*! Per connection outbound priority queues.
+
+Messages are handed to libsoup only when connection's send queue is flushed, one message or
+fragment at a time taken from the highest priority non empty lane. Text messages up to
+`fragment_size` are sent as they are, larger text messages and all binary messages are sent
+as binary fragments with 3 bytes header (lane_tag, lane, SoupWebsocketDataType).
+\see lane_reassembler */
+class outbound_lanes : private boost::noncopyable {
+public:
+	using message_data = std::shared_ptr<std::string const>;  //!< shared by all connections of a broadcast
+
+	outbound_lanes(SoupWebsocketConnection * connection, size_t fragment_size);
+	~outbound_lanes();
+	void push(priority prio, message_data data, SoupWebsocketDataType type);
+	void pump();  //!< sends queued messages while connection's send queue is flushed
+	bool empty() const;
+
+private:
+	struct message {
+		message_data data;
+		SoupWebsocketDataType type;
+		size_t offset;  //!< already sent bytes
+	};
+
+	void send_next();
+	void wait_writable();
+	static gboolean writable_cb(GObject * stream, gpointer user_data);
+
+	SoupWebsocketConnection * _conn;
+	size_t const _fragment_size;
+	std::array<std::deque<message>, 3> _lanes;  //!< indexed by priority
+	GSource * _writable;  //!< connection writable source or nullptr
+	std::string _frame;  //!< reusable fragment buffer
+};
+
+/*! Reassembles fragmented messages sent by outbound_lanes.
+\see outbound_lanes */
+class lane_reassembler {
+public:
+	lane_reassembler();
+
+	/*! \param[in] fragment received binary message
+	\param[out] type complete message type
+	\param[out] payload complete message, valid until the next feed() call
+	\return true if message is complete */
+	bool feed(std::string_view fragment, SoupWebsocketDataType & type, std::string_view & payload);
+
+private:
+	std::array<std::string, 3> _partial;  //!< indexed by priority
+	int _delivered;  //!< lane of the last delivered message to be cleared or -1
+};
+
+bool output_flushed(SoupWebsocketConnection * conn);
+
+}  // detail
+
+}  // websocket
@@ -0,0 +1,253 @@
+#include <cstring>
+#include <cassert>
+#include <iostream>
+#include "rpc.hpp"
+
+using std::string, std::string_view, std::vector, std::cout;
+using std::chrono::steady_clock, std::chrono::milliseconds;
+using std::filesystem::path;
+
+namespace websocket {
+
+namespace detail {
+
+void attach_timeout(GSource *& source, milliseconds interval, GSourceFunc func, gpointer data);
+void destroy_source(GSource *& source);
+
+}  // detail
+
+namespace {
+
+constexpr size_t HEADER_SIZE = 6;  // tag, id, method size (request) or status (response)
+
+constexpr milliseconds SWEEP_INTERVAL{10};  //!< call timeout resolution
+
+uint32_t read_id(string_view msg) {
+	uint32_t id;
+	memcpy(&id, msg.data() + 1, sizeof(id));
+	return id;
+}
+
+void write_header(string & frame, rpc_tag tag, uint32_t id, uint8_t field) {
+	frame.resize(HEADER_SIZE);
+	frame[0] = char(tag);
+	memcpy(frame.data() + 1, &id, sizeof(id));
+	frame[5] = char(field);
+}
+
+}  // namespace
+
+char const * to_string(rpc_status status) {
+	switch (status) {
+		case rpc_status::ok: return "ok";
+		case rpc_status::error: return "error";
+		case rpc_status::unknown_method: return "unknown method";
+		case rpc_status::timeout: return "timeout";
+		case rpc_status::disconnected: return "disconnected";
+		default: return "unknown";
+	}
+}
+
+namespace detail {
+
+rpc_call_table::rpc_call_table(size_t capacity)
+	: _slots(capacity)
+	, _size{0}
+{
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+}
+
+void rpc_call_table::insert(uint32_t id, time_point deadline, handler_type && handler) {
+	assert(id != 0);
+
+	if (2*(_size + 1) > _slots.size())  // keep load factor under 1/2
+		grow();
+
+	size_t const mask = _slots.size() - 1;
+	size_t i = index(id);
+	while (_slots[i].id != 0) {
+		assert(_slots[i].id != id);
+		i = (i + 1) & mask;
+	}
+
+	_slots[i].id = id;
+	_slots[i].deadline = deadline;
+	_slots[i].handler = std::move(handler);
+	++_size;
+}
+
+bool rpc_call_table::take(uint32_t id, handler_type & handler) {
+	if (id == 0)
+		return false;
+
+	size_t const mask = _slots.size() - 1;
+	size_t i = index(id);
+	while (_slots[i].id != id) {
+		if (_slots[i].id == 0)
+			return false;
+		i = (i + 1) & mask;
+	}
+
+	handler = std::move(_slots[i].handler);
+
+	// backward shift deletion, move following slots of the cluster to the hole if possible
+	for (size_t j = (i + 1) & mask; _slots[j].id != 0; j = (j + 1) & mask) {
+		size_t const home = index(_slots[j].id);
+		if (((j - home) & mask) >= ((j - i) & mask)) {  // hole is on j's probe path
+			_slots[i] = std::move(_slots[j]);
+			i = j;
+		}
+	}
+
+	_slots[i].id = 0;
+	_slots[i].handler = nullptr;
+	--_size;
+	return true;
+}
+
+void rpc_call_table::expired(time_point now, vector<uint32_t> & ids) const {
+	ids.clear();
+	for (slot const & s : _slots)
+		if (s.id != 0 && s.deadline <= now)
+			ids.push_back(s.id);
+}
+
+size_t rpc_call_table::size() const {
+	return _size;
+}
+
+size_t rpc_call_table::capacity() const {
+	return _slots.size();
+}
+
+size_t rpc_call_table::index(uint32_t id) const {
+	return id & (_slots.size() - 1);
+}
+
+void rpc_call_table::grow() {
+	vector<slot> slots(2*_slots.size());
+	swap(slots, _slots);
+	_size = 0;
+	for (slot & s : slots)
+		if (s.id != 0)
+			insert(s.id, s.deadline, std::move(s.handler));
+}
+
+}  // detail
+
+
+rpc_client_channel::rpc_client_channel()
+	: _next_id{1}
+	, _sweep{nullptr}
+{}
+
+rpc_client_channel::rpc_client_channel(path const & ssl_cert_file)
+	: client_channel{ssl_cert_file}
+	, _next_id{1}
+	, _sweep{nullptr}
+{}
+
+rpc_client_channel::~rpc_client_channel() {
+	detail::destroy_source(_sweep);
+}
+
+bool rpc_client_channel::call(string_view method, string_view request, response_handler && handler,
+	milliseconds timeout) {
+
+	if (size(method) > 255) {
+		cout << "rpc: method name '" << method << "' too long\n";
+		return false;
+	}
+
+	uint32_t const id = _next_id;
+	_next_id = _next_id == UINT32_MAX ? 1 : _next_id + 1;  // 0 is reserved for empty slot
+
+	write_header(_frame, rpc_tag::request, id, uint8_t(size(method)));
+	_frame.append(method.data(), method.size());
+	_frame.append(request.data(), request.size());
+
+	_calls.insert(id, steady_clock::now() + timeout, std::move(handler));
+	if (!_sweep)
+		detail::attach_timeout(_sweep, SWEEP_INTERVAL, sweep_cb, this);
+
+	send_binary(_frame);
+	return true;
+}
+
+size_t rpc_client_channel::pending() const {
+	return _calls.size();
+}
+
+void rpc_client_channel::on_binary_message(string_view msg) {
+	if (size(msg) < HEADER_SIZE || rpc_tag(msg[0]) != rpc_tag::response) {
+		cout << "rpc: malformed response received, ignored\n";
+		return;
+	}
+
+	response_handler handler;
+	if (!_calls.take(read_id(msg), handler))
+		return;  // late response for already timed out call
+
+	// handler is taken out of the table first, so it can make another call
+	handler(rpc_status(msg[5]), msg.substr(HEADER_SIZE));
+}
+
+void rpc_client_channel::on_closed() {
+	// no response can arrive anymore, fail all pending calls
+	detail::destroy_source(_sweep);
+	_calls.expired(steady_clock::time_point::max(), _expired);
+	for (uint32_t id : _expired) {
+		response_handler handler;
+		if (_calls.take(id, handler))
+			handler(rpc_status::disconnected, string_view{});
+	}
+}
+
+void rpc_client_channel::sweep() {
+	_calls.expired(steady_clock::now(), _expired);
+	for (uint32_t id : _expired) {
+		response_handler handler;
+		if (_calls.take(id, handler))
+			handler(rpc_status::timeout, string_view{});
+	}
+}
+
+gboolean rpc_client_channel::sweep_cb(gpointer user_data) {
+	rpc_client_channel * channel = static_cast<rpc_client_channel *>(user_data);
+	assert(channel);
+	channel->sweep();
+	if (channel->pending() > 0)
+		return G_SOURCE_CONTINUE;
+
+	detail::destroy_source(channel->_sweep);
+	return G_SOURCE_REMOVE;
+}
+
+
+void rpc_server_channel::bind(string const & method, method_handler && handler) {
+	assert(size(method) <= 255);
+	_methods[method] = std::move(handler);
+}
+
+void rpc_server_channel::on_binary_message(SoupWebsocketConnection * connection, string_view msg) {
+	if (size(msg) < HEADER_SIZE || rpc_tag(msg[0]) != rpc_tag::request
+		|| size(msg) < HEADER_SIZE + uint8_t(msg[5])) {
+		cout << "rpc: malformed request received, ignored\n";
+		return;
+	}
+
+	uint32_t const id = read_id(msg);
+	string_view const method = msg.substr(HEADER_SIZE, uint8_t(msg[5])),
+		request = msg.substr(HEADER_SIZE + size(method));
+
+	rpc_status status = rpc_status::unknown_method;
+	_response.clear();  // capacity is reused
+	if (auto it = _methods.find(method); it != end(_methods))
+		status = it->second(request, _response) ? rpc_status::ok : rpc_status::error;
+
+	write_header(_frame, rpc_tag::response, id, uint8_t(status));
+	_frame.append(_response);
+	send_binary(connection, _frame);
+}
+
+}  // websocket
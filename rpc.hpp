@@ -0,0 +1,144 @@
+/*! \file
+Pipelined request/response (RPC) over WebSocket channels, many requests can be in flight over
+one connection, responses are matched with requests by correlation id.
+
+\code
+struct calc_server : public websocket::rpc_server_channel {
+	calc_server() {
+		bind("echo", [](string_view request, string & response){
+			response = request;
+			return true;
+		});
+	}
+};
+
+rpc_client_channel client;
+// ... connect
+client.call("echo", "hello!", [](rpc_status status, string_view response){
+	if (status == rpc_status::ok)
+		cout << response << "\n";
+});
+\endcode */
+#pragma once
+#include <map>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <cstdint>
+#include "websocket.hpp"
+
+namespace websocket {
+
+//! RPC binary message tags (first byte of a binary message).
+enum class rpc_tag : uint8_t {
+	request = 0x20,
+	response = 0x21
+};
+
+enum class rpc_status : uint8_t {
+	ok,
+	error,  //!< method failed, response contains error message
+	unknown_method,
+	timeout,  //!< no response received in time (client side only)
+	disconnected  //!< connection closed before response received (client side only)
+};
+
+char const * to_string(rpc_status status);
+
+namespace detail {
+
+/*! Open addressing (linear probing) table of pending calls indexed by correlation id,
+slots are reused so the table itself doesn't allocate per call once it is grown.
+\note handler is `std::function`, so handler with captures larger than its small buffer (a few
+pointers, implementation defined) still allocates per call.
+\note ids are sequential, so `id & mask` is used as hash */
+class rpc_call_table {
+public:
+	using handler_type = std::function<void (rpc_status status, std::string_view response)>;
+	using time_point = std::chrono::steady_clock::time_point;
+
+	explicit rpc_call_table(size_t capacity = 64);  //!< \param[in] capacity power of two
+	void insert(uint32_t id, time_point deadline, handler_type && handler);
+
+	//! Removes call from the table, \return false if there is no call with `id`
+	bool take(uint32_t id, handler_type & handler);
+
+	void expired(time_point now, std::vector<uint32_t> & ids) const;  //!< \param[out] ids expired calls
+	size_t size() const;
+	size_t capacity() const;
+
+private:
+	struct slot {
+		uint32_t id;  //!< 0 for empty slot
+		time_point deadline;
+		handler_type handler;
+	};
+
+	size_t index(uint32_t id) const;
+	void grow();
+
+	std::vector<slot> _slots;
+	size_t _size;
+};
+
+}  // detail
+
+/*! RPC client channel, requests are sent without waiting for previous responses (pipelined).
+Call timeouts are checked by a single timer driven by thread-default main loop.
+\note channel needs to be connected before call() */
+class rpc_client_channel : public client_channel {
+public:
+	using response_handler = detail::rpc_call_table::handler_type;
+
+	rpc_client_channel();
+	explicit rpc_client_channel(std::filesystem::path const & ssl_cert_file);
+	~rpc_client_channel();
+
+	/*! Sends request for `method`, `handler` is called with response, with rpc_status::timeout
+	in case response doesn't arrive in time or with rpc_status::disconnected in case connection
+	is closed before response arrives.
+	\return false if request can not be sent (method name longer than 255 characters) */
+	bool call(std::string_view method, std::string_view request, response_handler && handler,
+		std::chrono::milliseconds timeout = std::chrono::seconds{5});
+
+	size_t pending() const;  //!< \return number of calls waiting for response
+
+protected:
+	void on_binary_message(std::string_view msg) override;
+	void on_closed() override;
+
+private:
+	void sweep();
+	static gboolean sweep_cb(gpointer user_data);
+
+	detail::rpc_call_table _calls;
+	uint32_t _next_id;
+	GSource * _sweep;  //!< timeout timer, nullptr if there is no pending call
+	std::string _frame;  //!< reusable buffers
+	std::vector<uint32_t> _expired;
+};
+
+/*! RPC server channel, dispatches requests to bound method handlers and sends response back to
+requesting client only. */
+class rpc_server_channel : public server_channel {
+public:
+	/*! \param[out] response response or error message
+	\return false in case of error */
+	using method_handler = std::function<bool (std::string_view request, std::string & response)>;
+
+	using server_channel::server_channel;  // reuse constructors
+	void bind(std::string const & method, method_handler && handler);
+
+protected:
+	using server_channel::on_binary_message;
+	void on_binary_message(SoupWebsocketConnection * connection, std::string_view msg) override;
+
+private:
+	std::map<std::string, method_handler, std::less<>> _methods;
+	std::string _response;  //!< reusable buffers
+	std::string _frame;
+};
+
+}  // websocket
@@ -4,12 +4,25 @@
 #include <future>
 #include <functional>
 #include <iostream>
+#include <random>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+#include <unistd.h>
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 #include "jthread.hpp"
 #include "glib_event_loop.hpp"
 #include "echo_server.hpp"
 #include "channel_receiver.hpp"
+#include "loopback.hpp"
+#include "traffic_recorder.hpp"
+#include "last_value_cache.hpp"
+#include "delta_codec.hpp"
+#include "frame_kernels.hpp"
+#include "typed_channel.hpp"
+#include "priority_lanes.hpp"
+#include "rpc.hpp"
 
 using namespace std::chrono_literals;
 
@@ -17,6 +30,7 @@ using std::vector, std::string, std::to_string;
 using std::chrono::seconds, std::chrono::milliseconds;
 using std::promise, std::future_status;
 using std::ref, std::cout;
+using std::filesystem::temp_directory_path;
 
 
 namespace {
@@ -58,22 +72,16 @@ TEST_CASE("we can send and receive messages via WebSocket channel",
 	"[websocket][channel_receiver_async]") {
 	// SETUP
 	string const expected_result = "hello c9a3cf13e!";
-
-	// run echo server
 	constexpr seconds timeout = 3s;
-	bool server_quit = false;
-	jthread server_thread{run_echo_server, PORT, "/echo", ref(server_quit), timeout};
-	std::this_thread::sleep_for(milliseconds{100});  // wait for server
 
-	// run client
 	glib_event_loop loop;
+	echo_server server;  // in-process, no listening required
 
 	promise<string> result_promise;
-	string const addr = "ws://localhost:" + to_string(PORT) + "/echo";
 	channel_receiver_async client{result_promise};
-	client.connect(addr, [&client, expected_result](std::error_code const & ec) {
+	REQUIRE(websocket::connect_loopback(server, client, [&client, expected_result](std::error_code const & ec) {
 		client.send(expected_result);
-	});
+	}));
 
 	loop.go_while([&client]{return !client.received;}, timeout);
 
@@ -82,34 +90,24 @@ TEST_CASE("we can send and receive messages via WebSocket channel",
 	REQUIRE(result_future.wait_for(timeout) == future_status::ready);
 	string result = result_future.get();
 	REQUIRE(result == expected_result);
-
-	// CLEAN-UP
-	server_quit = true;
-	server_thread.join();
 }
 
 TEST_CASE("we can send and receive multiple messages via WebSocket channel",
 	"[websocket][channel_receiver_multi_async]") {
 	// SETUP
 	vector<string> expected_messages = {"1", "2", "3", "4", "5"};
-
-	// run echo server
 	constexpr seconds timeout = 3s;
-	bool server_quit = false;
-	jthread server_thread{run_echo_server, PORT, "/echo", std::ref(server_quit), timeout};
-	std::this_thread::sleep_for(milliseconds{100});  // wait for server
 
-	// run client
 	glib_event_loop loop;
+	echo_server server;
 
 	channel_receiver_multi_async::promise_type result_promise;
-	string const addr = "ws://localhost:" + to_string(PORT) + "/echo";
 	channel_receiver_multi_async client{size(expected_messages), result_promise};
-	client.connect(addr, [&client, expected_messages](std::error_code const & ec) {
+	REQUIRE(websocket::connect_loopback(server, client, [&client, expected_messages](std::error_code const & ec) {
 		for_each(begin(expected_messages), end(expected_messages), [&client](string const & msg){
 			client.send(msg);
 		});
-	});
+	}));
 
 	loop.go_while([&client]{return !client.received;}, timeout);
 
@@ -118,8 +116,819 @@ TEST_CASE("we can send and receive multiple messages via WebSocket channel",
 	REQUIRE(result_future.wait_for(timeout) == future_status::ready);
 	vector<string> result = result_future.get();
 	REQUIRE(result == expected_messages);
+}
+
+TEST_CASE("we can send and receive messages via Unix domain socket",
+	"[websocket][unix_socket]") {
+	// SETUP
+	string const expected_result = "hello 7f1e2d!";
+	constexpr seconds timeout = 3s;
+
+	glib_event_loop loop;
+	echo_server server;
+	REQUIRE(server.listen_unix("@websocket_test", "/echo"));  // abstract namespace socket
+
+	promise<string> result_promise;
+	channel_receiver_async client{result_promise};
+	client.connect_unix("@websocket_test", "/echo", [&client, expected_result](std::error_code const & ec) {
+		client.send(expected_result);
+	});
+
+	loop.go_while([&client]{return !client.received;}, timeout);
+
+	// CHECK
+	auto result_future = result_promise.get_future();
+	REQUIRE(result_future.wait_for(timeout) == future_status::ready);
+	string result = result_future.get();
+	REQUIRE(result == expected_result);
+}
+
+TEST_CASE("Unix socket file of a running server is not taken over",
+	"[websocket][unix_socket]") {
+	string const socket_path = temp_directory_path() / "websocket_test.sock";
+
+	// stale socket file (nobody listening) e.g. after crash
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	REQUIRE(size(socket_path) < sizeof(addr.sun_path));
+	socket_path.copy(addr.sun_path, size(socket_path));
+	std::filesystem::remove(socket_path);
+	int const fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	REQUIRE(bind(fd, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) == 0);
+	close(fd);
+	REQUIRE(exists(std::filesystem::path{socket_path}));
+
+	glib_event_loop loop;
+	{
+		echo_server server;
+		REQUIRE(server.listen_unix(socket_path, "/echo"));  // stale file is replaced
+
+		echo_server second_server;
+		REQUIRE_FALSE(second_server.listen_unix(socket_path, "/echo"));  // path is in use
+	}
+
+	bool const removed = !exists(std::filesystem::path{socket_path});
 
 	// CLEAN-UP
-	server_quit = true;
-	server_thread.join();
+	std::filesystem::remove(socket_path);
+
+	// CHECK socket file is removed with the server
+	REQUIRE(removed);
+}
+
+TEST_CASE("we can record traffic and read it back",
+	"[traffic_recorder][traffic_log]") {
+	// SETUP
+	auto const log_file = temp_directory_path() / "websocket_test_traffic.log";
+	vector<string> const payloads = {"hello!", "", string(10000, 'x')};  // last one forces log to grow
+
+	{
+		websocket::traffic_recorder rec{log_file, 16};
+		REQUIRE(rec.is_open());
+		for (size_t i = 0; i < size(payloads); ++i)
+			rec.record(websocket::traffic_direction::inbound, i + 1, SOUP_WEBSOCKET_DATA_TEXT, payloads[i]);
+	}
+
+	// CHECK
+	websocket::traffic_log log{log_file};
+	REQUIRE(log.is_open());
+
+	vector<string> result;
+	for (websocket::traffic_record rec; log.next(rec);) {
+		REQUIRE(rec.connection == size(result) + 1);
+		REQUIRE(rec.direction == websocket::traffic_direction::inbound);
+		REQUIRE(rec.type == SOUP_WEBSOCKET_DATA_TEXT);
+		result.push_back(string{rec.payload});
+	}
+
+	REQUIRE(result == payloads);
+
+	// CLEAN-UP
+	remove(log_file);
+}
+
+TEST_CASE("last value cache keeps last value per key and evicts least recently updated keys",
+	"[last_value_cache]") {
+	websocket::last_value_cache cache{12};
+
+	cache.update("b", "1");
+	cache.update("a", "1");
+	cache.update("b", "22");
+	REQUIRE(cache.size() == 2);
+	REQUIRE(cache.bytes() == 5);
+	REQUIRE(cache.find("b") == "22");
+
+	vector<string> keys;
+	cache.for_each([&keys](std::string_view key, std::string_view){keys.emplace_back(key);});
+	REQUIRE(keys == vector<string>{"a", "b"});  // key order
+
+	cache.update("c", "12345");  // 12 bytes, full
+	cache.update("d", "1");  // "a" is the least recently updated
+	REQUIRE(cache.find("a").empty());
+	REQUIRE(cache.find("d") == "1");
+	REQUIRE(cache.bytes() <= 12);
+
+	cache.update("e", string(20, 'x'));  // too large to be cached
+	REQUIRE(cache.find("e").empty());
+
+	cache.update("d", string(20, 'x'));  // too large value replaces cached one
+	REQUIRE(cache.find("d").empty());
+	REQUIRE(cache.bytes() <= 12);
+}
+
+TEST_CASE("late joining client receives last value of each key",
+	"[websocket][snapshot]") {
+	// SETUP
+	glib_event_loop loop;
+	websocket::server_channel server;
+	server.enable_snapshot(1024);
+
+	// nobody is connected yet
+	server.send_all("USDJPY", R"({"bid":151.22})");
+	server.send_all("EURUSD", R"({"bid":1.0712})");
+	server.send_all("EURUSD", R"({"bid":1.0713})");
+
+	channel_receiver_multi_async::promise_type result_promise;
+	channel_receiver_multi_async client{2, result_promise};
+	REQUIRE(websocket::connect_loopback(server, client, [](std::error_code const & ec){}));
+
+	loop.go_while([&client]{return !client.received;}, 3s);
+
+	// CHECK (values are sent in key order)
+	auto result_future = result_promise.get_future();
+	REQUIRE(result_future.wait_for(0s) == future_status::ready);
+	REQUIRE(result_future.get() == vector<string>{R"({"bid":1.0713})", R"({"bid":151.22})"});
+}
+
+namespace {
+
+constexpr int DRAIN_PORT = 41003;
+
+/*! Connects plain TCP peer (no WebSocket implementation, so test controls close handshake)
+and sends WebSocket upgrade request, \return peer socket */
+int connect_raw_peer(int port) {
+	int const fd = socket(AF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	REQUIRE(fd != -1);
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	REQUIRE(connect(fd, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) == 0);
+
+	string const request = string{"GET "} + PATH + " HTTP/1.1\r\n"
+		"Host: localhost\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+		"Sec-WebSocket-Version: 13\r\n\r\n";
+	REQUIRE(write(fd, request.data(), size(request)) == ssize_t(size(request)));
+	return fd;
+}
+
+//! Appends data available on `fd` (without blocking) to `buf`.
+void receive_available(int fd, string & buf) {
+	char chunk[1024];
+	for (ssize_t n; (n = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT)) > 0;)
+		buf.append(chunk, n);
+}
+
+//! Runs loop until peer is upgraded, \return upgrade response size
+size_t wait_upgraded(glib_event_loop & loop, int peer, string & received) {
+	loop.go_while([peer, &received]{
+		receive_available(peer, received);
+		return received.find("\r\n\r\n") == string::npos;
+	}, 3s);
+
+	REQUIRE(received.find(" 101 ") != string::npos);
+	return received.find("\r\n\r\n") + 4;
+}
+
+}  // namespace
+
+TEST_CASE("drain closes clients with going away close code",
+	"[websocket][drain]") {
+	// SETUP
+	glib_event_loop loop;
+	websocket::server_channel server;
+	REQUIRE(server.listen(DRAIN_PORT, PATH));
+
+	int const peer = connect_raw_peer(DRAIN_PORT);
+	string received;
+	size_t const frame = wait_upgraded(loop, peer, received);
+
+	bool drained = false;
+	server.drain(3s, [&drained]{drained = true;});
+	REQUIRE(server.draining());
+
+	loop.go_while([peer, &received, frame]{
+		receive_available(peer, received);
+		return size(received) < frame + 4;
+	}, 2s);
+
+	// CHECK close frame (FIN + close opcode, close code 1001 going away)
+	REQUIRE(size(received) >= frame + 4);
+	REQUIRE(uint8_t(received[frame]) == 0x88);
+	REQUIRE(uint8_t(received[frame + 2]) == 0x03);
+	REQUIRE(uint8_t(received[frame + 3]) == 0xe9);
+
+	// answer close (masked with zero key), drain finishes before deadline
+	char const close_frame[] = {char(0x88), char(0x82), 0, 0, 0, 0, 0x03, char(0xe9)};
+	REQUIRE(write(peer, close_frame, sizeof(close_frame)) == sizeof(close_frame));
+	loop.go_while([&drained]{return !drained;}, 2s);
+	REQUIRE(drained);
+
+	// CLEAN-UP
+	close(peer);
+}
+
+TEST_CASE("broadcast skips clients closed by drain",
+	"[websocket][drain]") {
+	// SETUP
+	glib_event_loop loop;
+	websocket::server_channel server;
+	REQUIRE(server.listen(DRAIN_PORT, PATH));
+
+	int const peer = connect_raw_peer(DRAIN_PORT);  // doesn't answer close frame, stays closing
+	string received;
+	size_t const frame = wait_upgraded(loop, peer, received);
+
+	server.drain(3s, []{});
+	loop.go_while([peer, &received, frame]{
+		receive_available(peer, received);
+		return size(received) < frame + 4;
+	}, 2s);
+	REQUIRE(size(received) >= frame + 4);
+
+	// libsoup reports send to closing connection as critical warning
+	size_t criticals = 0;
+	guint const handler = g_log_set_handler("libsoup", G_LOG_LEVEL_CRITICAL,
+		[](gchar const *, GLogLevelFlags, gchar const *, gpointer criticals){
+			++*static_cast<size_t *>(criticals);
+		}, &criticals);
+
+	server.send_all("late message");
+	server.send_all_binary("late binary message");
+	server.send_all("EURUSD", "late keyed message");
+	loop.go_while([]{return true;}, 100ms);
+	receive_available(peer, received);
+
+	g_log_remove_handler("libsoup", handler);
+
+	// CHECK
+	REQUIRE(criticals == 0);
+	REQUIRE(received.find("late") == string::npos);
+
+	// CLEAN-UP
+	close(peer);
+}
+
+TEST_CASE("drain drops clients which do not close before deadline",
+	"[websocket][drain]") {
+	// SETUP
+	glib_event_loop loop;
+	websocket::server_channel server;
+	REQUIRE(server.listen(DRAIN_PORT, PATH));
+
+	int const peer = connect_raw_peer(DRAIN_PORT);  // never answers close frame
+	string received;
+	wait_upgraded(loop, peer, received);
+
+	bool drained = false;
+	auto const start = std::chrono::steady_clock::now();
+	server.drain(100ms, [&drained]{drained = true;});
+	loop.go_while([&drained]{return !drained;}, 3s);
+
+	// CHECK
+	REQUIRE(drained);
+	REQUIRE(std::chrono::steady_clock::now() - start >= 100ms);
+
+	// CLEAN-UP
+	close(peer);
+}
+
+TEST_CASE("drained server doesn't accept new connections",
+	"[websocket][drain]") {
+	glib_event_loop loop;
+	websocket::server_channel server;
+	REQUIRE(server.listen(DRAIN_PORT, PATH));
+
+	bool drained = false;
+	server.drain(1s, [&drained]{drained = true;});
+	REQUIRE(drained);  // no client
+
+	bool connected = false;
+	websocket::client_channel client;
+	client.connect("ws://localhost:" + to_string(DRAIN_PORT) + PATH, [&connected](std::error_code const & ec){
+		connected = true;
+	});
+
+	loop.go_while([&connected]{return !connected;}, 500ms);
+	REQUIRE_FALSE(connected);
+}
+
+TEST_CASE("more servers can listen on the same port with reuse port option",
+	"[websocket][reuse_port]") {
+	glib_event_loop loop;
+	websocket::server_channel first, second, third;
+	REQUIRE(first.listen(DRAIN_PORT, PATH, true));
+	REQUIRE(second.listen(DRAIN_PORT, PATH, true));
+	REQUIRE_FALSE(third.listen(DRAIN_PORT, PATH));  // port is taken without the option
+}
+
+TEST_CASE("delta encoded message can be reconstructed from baseline",
+	"[delta_codec]") {
+	string const baseline = R"({"ts":1700000000000,"bid":1.0712,"ask":1.0714,"volume":1200,"symbol":"EURUSD"})";
+
+	vector<string> const targets = {
+		baseline,  // no change
+		R"({"ts":1700000000042,"bid":1.0713,"ask":1.0714,"volume":1200,"symbol":"EURUSD"})",  // same layout
+		R"({"ts":1700000000042,"bid":1.07125,"ask":1.0714,"volume":12000,"symbol":"EURUSD"})",  // inserted bytes
+		R"({"ts":17,"ask":1.0714,"symbol":"EURUSD"})",  // removed bytes
+		"",
+		string(1000, 'x')
+	};
+
+	for (string const & target : targets) {
+		string delta;
+		websocket::delta_encode(baseline, target, delta);
+
+		string result;
+		REQUIRE(websocket::delta_decode(baseline, delta, result));
+		REQUIRE(result == target);
+	}
+
+	// small change means small delta
+	string delta;
+	REQUIRE(websocket::delta_encode(baseline, targets[1], delta) < size(baseline) / 4);
+
+	// malformed delta
+	string result;
+	REQUIRE_FALSE(websocket::delta_decode(baseline, delta.substr(0, size(delta) - 1), result));
+	REQUIRE_FALSE(websocket::delta_decode(baseline, string{"\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01", 10}, result));  // huge target size
+}
+
+TEST_CASE("delta mode keeps separate stream for each key",
+	"[websocket][delta]") {
+	// SETUP
+	vector<string> const expected_messages = {
+		R"({"symbol":"EURUSD","bid":1.0712})",
+		R"({"symbol":"USDJPY","bid":151.22})",
+		R"({"symbol":"EURUSD","bid":1.0713})",
+		R"({"symbol":"USDJPY","bid":151.23})",
+		R"({"default":1})"
+	};
+	constexpr seconds timeout = 3s;
+
+	glib_event_loop loop;
+	websocket::server_channel server;
+	server.enable_delta();
+
+	channel_receiver_multi_async::promise_type result_promise;
+	channel_receiver_multi_async client{size(expected_messages), result_promise};
+	client.enable_delta();
+	REQUIRE(websocket::connect_loopback(server, client, [](std::error_code const & ec){}));
+
+	// interleaved streams
+	for (size_t i = 0; i < 4; ++i)
+		server.send_all(i % 2 ? "USDJPY" : "EURUSD", expected_messages[i]);
+	server.send_all(expected_messages[4]);
+
+	loop.go_while([&client]{return !client.received;}, timeout);
+
+	// CHECK
+	auto result_future = result_promise.get_future();
+	REQUIRE(result_future.wait_for(timeout) == future_status::ready);
+	REQUIRE(result_future.get() == expected_messages);
+}
+
+namespace {
+
+//! Client channel without delta mode, keeps raw frames as received.
+struct frame_receiver : public websocket::client_channel {
+	vector<std::pair<bool, string>> frames;  //!< (binary, payload)
+
+private:
+	void on_message(std::string_view msg) override {
+		frames.emplace_back(false, string{msg});
+	}
+
+	void on_binary_message(std::string_view msg) override {
+		frames.emplace_back(true, string{msg});
+	}
+};
+
+}  // namespace
+
+TEST_CASE("message with too long key doesn't touch default delta stream",
+	"[websocket][delta]") {
+	// SETUP
+	string const first = R"({"symbol":"EURUSD","bid":1.0712,"ask":1.0714,"venue":"primary","session":"london"})",
+		second = R"({"symbol":"EURUSD","bid":1.0713,"ask":1.0714,"venue":"primary","session":"london"})",
+		long_key(300, 'k'),
+		unrelated = "long key message";
+
+	glib_event_loop loop;
+	websocket::server_channel server;
+	server.enable_delta();
+
+	frame_receiver client;
+	REQUIRE(websocket::connect_loopback(server, client, [](std::error_code const & ec){}));
+
+	server.send_all(first);
+	server.send_all(long_key, unrelated);
+	server.send_all(second);
+
+	loop.go_while([&client]{return size(client.frames) < 3;}, 3s);
+
+	// CHECK
+	REQUIRE(size(client.frames) == 3);
+
+	// long key message is plain text
+	auto const & [binary, msg] = client.frames[1];
+	REQUIRE_FALSE(binary);
+	REQUIRE(msg == unrelated);
+
+	// default stream delta is computed against the first message
+	auto const & [keyframe_binary, keyframe] = client.frames[0];
+	REQUIRE(keyframe_binary);
+	REQUIRE(keyframe == string{char(websocket::delta_tag::keyframe), '\0'} + first);
+
+	auto const & [delta_binary, delta] = client.frames[2];
+	REQUIRE(delta_binary);
+	REQUIRE(size(delta) > 2);
+	REQUIRE(delta[0] == char(websocket::delta_tag::delta));
+	REQUIRE(delta[1] == '\0');
+
+	string reconstructed;
+	REQUIRE(websocket::delta_decode(first, std::string_view{delta}.substr(2), reconstructed));
+	REQUIRE(reconstructed == second);
+}
+
+TEST_CASE("SIMD frame kernels produce the same results as scalar versions",
+	"[frame_kernels]") {
+	using websocket::kernel_isa;
+
+	std::mt19937 rng{7};
+	string const samples[] = {"hello!", "žltý kôň", "€", "😀", "\xed\xa0\x80", "\xc0\xaf", "\xf4\x90\x80\x80"};
+
+	for (kernel_isa isa : {kernel_isa::sse2, kernel_isa::avx2}) {
+		if (!kernel_isa_supported(isa))
+			continue;
+
+		for (size_t i = 0; i < 2000; ++i) {
+			// random mix of ASCII, multibyte, invalid sequences and random bytes
+			string text;
+			size_t const parts = rng() % 40;
+			for (size_t p = 0; p < parts; ++p) {
+				switch (rng() % 4) {
+					case 0: text += string(rng() % 70, char('a' + rng() % 26)); break;
+					case 1: text += samples[rng() % size(samples)]; break;
+					case 2: text.push_back(char(rng())); break;
+					default: text += samples[1]; break;
+				}
+			}
+
+			if (!empty(text) && rng() % 4 == 0)  // cut in the middle of a sequence
+				text.resize(rng() % size(text));
+
+			REQUIRE(valid_utf8(isa, text) == valid_utf8(kernel_isa::scalar, text));
+
+			uint8_t const key[4] = {uint8_t(rng()), uint8_t(rng()), uint8_t(rng()), uint8_t(rng())};
+			size_t const key_offset = rng() % 4;
+			string masked = text, expected = text;
+			mask_payload(isa, key, data(masked), size(masked), key_offset);
+			mask_payload(kernel_isa::scalar, key, data(expected), size(expected), key_offset);
+			REQUIRE(masked == expected);
+
+			mask_payload(isa, key, data(masked), size(masked), key_offset);  // unmask
+			REQUIRE(masked == text);
+		}
+	}
+
+	REQUIRE(websocket::valid_utf8(samples[1]));
+	REQUIRE_FALSE(websocket::valid_utf8(samples[4]));  // surrogate
+	REQUIRE_FALSE(websocket::valid_utf8(samples[5]));  // overlong
+}
+
+namespace {
+
+struct quote {
+	char symbol[8];
+	double bid, ask;
+};
+
+bool from_json(std::string_view json, quote & q) {  // minimal parser for testing purpose
+	return sscanf(string{json}.c_str(), R"({"symbol":"%7[^"]","bid":%lf,"ask":%lf})", q.symbol, &q.bid, &q.ask) == 3;
+}
+
+void to_json(quote const & q, string & json) {
+	char buf[128];
+	snprintf(buf, sizeof(buf), R"({"symbol":"%s","bid":%g,"ask":%g})", q.symbol, q.bid, q.ask);
+	json += buf;
+}
+
+template <typename Codec>
+quote codec_round_trip(quote const & q) {
+	string buf;
+	Codec::encode(q, buf);
+	quote result = {};
+	REQUIRE(Codec::decode(buf, result));
+	return result;
+}
+
+template <typename Codec>
+struct quote_echo_server
+	: public websocket::typed_server_channel<quote_echo_server<Codec>, quote, Codec> {
+
+	void on_message(quote const & q) {
+		this->send_all(q);
+	}
+};
+
+template <typename Codec>
+struct quote_client : public websocket::typed_client_channel<quote_client<Codec>, quote, Codec> {
+	vector<quote> received;
+
+	void on_message(quote const & q) {
+		received.push_back(q);
+	}
+};
+
+//! Sends `q` to typed echo server over loopback transport, \return quotes received back
+template <typename Codec>
+vector<quote> channel_round_trip(quote const & q) {
+	glib_event_loop loop;
+	quote_echo_server<Codec> server;
+	quote_client<Codec> client;
+	REQUIRE(websocket::connect_loopback(server, client, [&client, q](std::error_code const & ec){
+		client.send(q);
+	}));
+
+	loop.go_while([&client]{return client.received.empty();}, 3s);
+	return client.received;
+}
+
+}  // namespace
+
+TEST_CASE("typed channel codecs can decode encoded messages",
+	"[typed_channel]") {
+	quote const q = {"EURUSD", 1.0712, 1.0714};
+
+	for (quote const & result : {codec_round_trip<websocket::pod_codec<quote>>(q),
+		codec_round_trip<websocket::json_codec<quote>>(q)}) {
+		REQUIRE(string{result.symbol} == q.symbol);
+		REQUIRE(result.bid == q.bid);
+		REQUIRE(result.ask == q.ask);
+	}
+
+	using websocket::length_prefixed_codec;
+	string const long_field(300, 'x');  // fields are views, so the field data needs to outlive them
+	length_prefixed_codec::message_type const fields = {"EURUSD", "", long_field};
+	string buf;
+	length_prefixed_codec::encode(fields, buf);
+
+	length_prefixed_codec::message_type result;
+	REQUIRE(length_prefixed_codec::decode(buf, result));
+	REQUIRE(result == fields);
+	REQUIRE(result[0].data() >= buf.data());  // decoded in place
+	REQUIRE_FALSE(length_prefixed_codec::decode(buf.substr(0, size(buf) - 1), result));
+}
+
+TEST_CASE("typed channels can exchange messages",
+	"[typed_channel]") {
+	quote const q = {"EURUSD", 1.0712, 1.0714};
+
+	for (vector<quote> const & received : {channel_round_trip<websocket::pod_codec<quote>>(q),
+		channel_round_trip<websocket::json_codec<quote>>(q)}) {
+		REQUIRE(size(received) == 1);
+		REQUIRE(string{received[0].symbol} == q.symbol);
+		REQUIRE(received[0].bid == q.bid);
+		REQUIRE(received[0].ask == q.ask);
+	}
+}
+
+TEST_CASE("priority lanes fragments are reassembled per lane",
+	"[priority_lanes]") {
+	using websocket::lane_tag, websocket::priority;
+
+	auto fragment = [](lane_tag tag, priority prio, SoupWebsocketDataType type, string const & data){
+		return string{char(tag), char(prio), char(type)} + data;
+	};
+
+	websocket::detail::lane_reassembler reassembler;
+	SoupWebsocketDataType type;
+	std::string_view payload;
+
+	// bulk message interrupted by control message
+	string const bulk_first = fragment(lane_tag::fragment, priority::bulk, SOUP_WEBSOCKET_DATA_TEXT, "large "),
+		control = fragment(lane_tag::last_fragment, priority::control, SOUP_WEBSOCKET_DATA_BINARY, "ping"),
+		bulk_last = fragment(lane_tag::last_fragment, priority::bulk, SOUP_WEBSOCKET_DATA_TEXT, "snapshot");
+
+	REQUIRE_FALSE(reassembler.feed(bulk_first, type, payload));
+
+	REQUIRE(reassembler.feed(control, type, payload));
+	REQUIRE(type == SOUP_WEBSOCKET_DATA_BINARY);
+	REQUIRE(payload == "ping");
+
+	REQUIRE(reassembler.feed(bulk_last, type, payload));
+	REQUIRE(type == SOUP_WEBSOCKET_DATA_TEXT);
+	REQUIRE(payload == "large snapshot");
+
+	// lane is cleared after message is delivered
+	REQUIRE(reassembler.feed(bulk_last, type, payload));
+	REQUIRE(payload == "snapshot");
+
+	// malformed fragments
+	REQUIRE_FALSE(reassembler.feed("x", type, payload));
+	REQUIRE_FALSE(reassembler.feed(string{char(lane_tag::last_fragment), 7, 1}, type, payload));
+}
+
+TEST_CASE("control message overtakes queued bulk message in priority lanes",
+	"[websocket][priority_lanes]") {
+	// SETUP
+	string const bulk(4 << 20, 'b'),  // more than socket buffer, so fragments are queued in lanes
+		control = "ping";
+	constexpr seconds timeout = 3s;
+
+	glib_event_loop loop;
+	websocket::server_channel server;
+	server.enable_priority_lanes(16*1024);
+
+	channel_receiver_multi_async::promise_type result_promise;
+	channel_receiver_multi_async client{2, result_promise};
+	client.enable_priority_lanes();
+	REQUIRE(websocket::connect_loopback(server, client, [](std::error_code const & ec){}));
+
+	server.send_all(bulk, websocket::priority::bulk);
+	server.send_all(control, websocket::priority::control);
+
+	loop.go_while([&client]{return !client.received;}, timeout);
+
+	// CHECK
+	auto result_future = result_promise.get_future();
+	REQUIRE(result_future.wait_for(timeout) == future_status::ready);
+	vector<string> const result = result_future.get();
+	REQUIRE(result[0] == control);
+	REQUIRE(result[1] == bulk);
+}
+
+TEST_CASE("drain waits for priority lanes to be sent",
+	"[websocket][priority_lanes][drain]") {
+	// SETUP
+	string const bulk(4 << 20, 'b');
+	constexpr seconds timeout = 3s;
+
+	glib_event_loop loop;
+	websocket::server_channel server;
+	server.enable_priority_lanes(16*1024);
+
+	channel_receiver_multi_async::promise_type result_promise;
+	channel_receiver_multi_async client{1, result_promise};
+	client.enable_priority_lanes();
+	REQUIRE(websocket::connect_loopback(server, client, [](std::error_code const & ec){}));
+
+	server.send_all(bulk, websocket::priority::bulk);
+
+	bool drained = false;
+	server.drain(timeout, [&drained]{drained = true;});
+	loop.go_while([&]{return !drained || !client.received;}, timeout);
+
+	// CHECK
+	REQUIRE(drained);
+	auto result_future = result_promise.get_future();
+	REQUIRE(result_future.wait_for(0s) == future_status::ready);
+	REQUIRE(result_future.get() == vector<string>{bulk});
+}
+
+TEST_CASE("pipelined RPC calls are matched with responses",
+	"[rpc]") {
+	using websocket::rpc_status;
+
+	// SETUP
+	constexpr size_t call_count = 100;
+	constexpr seconds timeout = 3s;
+
+	glib_event_loop loop;
+	websocket::rpc_server_channel server;
+	server.bind("echo", [](std::string_view request, string & response){
+		response = request;
+		return true;
+	});
+	server.bind("fail", [](std::string_view request, string & response){
+		response = "failed";
+		return false;
+	});
+
+	websocket::rpc_client_channel client;
+	bool connected = false;
+	REQUIRE(websocket::connect_loopback(server, client, [&connected](std::error_code const & ec){
+		connected = true;
+	}));
+	REQUIRE(connected);
+
+	// all calls are sent before the first response is received
+	vector<string> responses(call_count);
+	for (size_t i = 0; i < call_count; ++i)
+		REQUIRE(client.call("echo", to_string(i), [&responses, i](rpc_status status, std::string_view response){
+			REQUIRE(status == rpc_status::ok);
+			responses[i] = response;
+		}));
+
+	rpc_status fail_status = rpc_status::ok,
+		unknown_status = rpc_status::ok;
+	string fail_response;
+	client.call("fail", "", [&](rpc_status status, std::string_view response){
+		fail_status = status;
+		fail_response = response;
+	});
+	client.call("unknown", "", [&](rpc_status status, std::string_view){unknown_status = status;});
+
+	REQUIRE(client.pending() == call_count + 2);
+	loop.go_while([&client]{return client.pending() > 0;}, timeout);
+
+	// CHECK
+	REQUIRE(client.pending() == 0);
+	for (size_t i = 0; i < call_count; ++i)
+		REQUIRE(responses[i] == to_string(i));
+
+	REQUIRE(fail_status == rpc_status::error);
+	REQUIRE(fail_response == "failed");
+	REQUIRE(unknown_status == rpc_status::unknown_method);
+}
+
+TEST_CASE("RPC call times out without response",
+	"[rpc]") {
+	using websocket::rpc_status;
+
+	glib_event_loop loop;
+	websocket::server_channel server;  // doesn't respond to requests
+
+	websocket::rpc_client_channel client;
+	REQUIRE(websocket::connect_loopback(server, client, [](std::error_code const & ec){}));
+
+	rpc_status result = rpc_status::ok;
+	client.call("echo", "hello", [&result](rpc_status status, std::string_view){
+		result = status;
+	}, 50ms);
+
+	loop.go_while([&client]{return client.pending() > 0;}, 3s);
+
+	REQUIRE(result == rpc_status::timeout);
+}
+
+TEST_CASE("pending RPC calls fail when connection is closed",
+	"[rpc]") {
+	using websocket::rpc_status;
+
+	glib_event_loop loop;
+	websocket::server_channel server;  // doesn't respond to requests
+
+	websocket::rpc_client_channel client;
+	REQUIRE(websocket::connect_loopback(server, client, [](std::error_code const & ec){}));
+
+	vector<rpc_status> results;
+	for (size_t i = 0; i < 3; ++i) {
+		client.call("echo", "hello", [&results](rpc_status status, std::string_view){
+			results.push_back(status);
+		}, 10s);
+	}
+
+	server.drain(1s, []{});  // closes client connection
+	loop.go_while([&client]{return client.pending() > 0;}, 3s);
+
+	REQUIRE(client.pending() == 0);
+	REQUIRE(results == vector<rpc_status>(3, rpc_status::disconnected));
+}
+
+TEST_CASE("RPC call table finds calls after removals",
+	"[rpc]") {
+	using websocket::rpc_status;
+	websocket::detail::rpc_call_table table{4};  // grows
+	auto const deadline = std::chrono::steady_clock::now();
+
+	size_t called = 0;
+	for (uint32_t id = 1; id <= 100; ++id)
+		table.insert(id, deadline + milliseconds{id}, [&called](rpc_status, std::string_view){++called;});
+
+	REQUIRE(table.size() == 100);
+	REQUIRE(table.capacity() >= 200);
+
+	websocket::detail::rpc_call_table::handler_type handler;
+	for (uint32_t id = 1; id <= 100; id += 2) {
+		REQUIRE(table.take(id, handler));
+		handler(rpc_status::ok, {});
+	}
+
+	REQUIRE(called == 50);
+	REQUIRE_FALSE(table.take(1, handler));  // already taken
+	REQUIRE_FALSE(table.take(1000, handler));
+
+	vector<uint32_t> expired;
+	table.expired(deadline + milliseconds{10}, expired);
+	REQUIRE(size(expired) == 5);  // 2, 4, 6, 8, 10
+
+	for (uint32_t id = 2; id <= 100; id += 2)
+		REQUIRE(table.take(id, handler));
+	REQUIRE(table.size() == 0);
 }
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "traffic_recorder.hpp"
+
+using std::string_view, std::cout;
+using std::chrono::steady_clock, std::chrono::nanoseconds, std::chrono::duration_cast;
+using std::filesystem::path;
+
+namespace websocket {
+
+namespace {
+
+constexpr char MAGIC[8] = {'W', 'S', 'T', 'R', 'A', 'F', 'F', '1'};
+constexpr size_t RECORD_HEADER_SIZE = 24;
+
+//! Record header layout (host byte order).
+struct record_header {
+	uint64_t timestamp;
+	uint64_t connection;
+	uint32_t size;
+	uint8_t direction;
+	uint8_t type;
+	uint8_t reserved[2];
+};
+
+static_assert(sizeof(record_header) == RECORD_HEADER_SIZE);
+
+}  // namespace
+
+traffic_recorder::traffic_recorder(path const & log_file, size_t initial_capacity)
+	: _fd{-1}
+	, _data{nullptr}
+	, _capacity{0}
+	, _size{0}
+	, _start{steady_clock::now()}
+{
+	_fd = ::open(log_file.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if (_fd == -1) {
+		cout << "traffic recorder: unable to open " << log_file << ", what: " << strerror(errno) << "\n";
+		return;
+	}
+
+	if (!reserve(std::max(initial_capacity, sizeof(MAGIC)))) {
+		::close(_fd);
+		_fd = -1;
+		return;
+	}
+
+	memcpy(_data, MAGIC, sizeof(MAGIC));
+	_size = sizeof(MAGIC);
+}
+
+traffic_recorder::~traffic_recorder() {
+	if (_data)
+		munmap(_data, _capacity);
+
+	if (_fd != -1) {
+		// cut not used preallocated space
+		if (ftruncate(_fd, _size) == -1)
+			cout << "traffic recorder: unable to truncate log, what: " << strerror(errno) << "\n";
+		::close(_fd);
+	}
+}
+
+bool traffic_recorder::is_open() const {
+	return _data != nullptr;
+}
+
+void traffic_recorder::record(traffic_direction direction, uint64_t connection, uint8_t type,
+	string_view payload) {
+
+	if (!_data)
+		return;
+
+	size_t const record_size = RECORD_HEADER_SIZE + payload.size();
+	if (_size + record_size > _capacity && !reserve(_size + record_size))
+		return;  // record lost
+
+	record_header const header{
+		(uint64_t)duration_cast<nanoseconds>(steady_clock::now() - _start).count(),
+		connection,
+		(uint32_t)payload.size(),
+		(uint8_t)direction,
+		type,
+		{0, 0}
+	};
+
+	memcpy(_data + _size, &header, sizeof(header));
+	memcpy(_data + _size + sizeof(header), payload.data(), payload.size());
+	_size += record_size;
+}
+
+size_t traffic_recorder::size() const {
+	return _size;
+}
+
+bool traffic_recorder::reserve(size_t bytes) {
+	assert(_fd != -1);
+
+	size_t capacity = std::max(_capacity, size_t{4096});
+	while (capacity < bytes)
+		capacity *= 2;
+
+	if (ftruncate(_fd, capacity) == -1) {
+		cout << "traffic recorder: unable to resize log, what: " << strerror(errno) << "\n";
+		return false;
+	}
+
+	void * data = _data ?
+		mremap(_data, _capacity, capacity, MREMAP_MAYMOVE) :
+		mmap(nullptr, capacity, PROT_READ|PROT_WRITE, MAP_SHARED, _fd, 0);
+
+	if (data == MAP_FAILED) {
+		cout << "traffic recorder: unable to map log, what: " << strerror(errno) << "\n";
+		return false;
+	}
+
+	_data = static_cast<char *>(data);
+	_capacity = capacity;
+	return true;
+}
+
+
+traffic_log::traffic_log(path const & log_file)
+	: _data{nullptr}
+	, _size{0}
+	, _offset{sizeof(MAGIC)}
+{
+	int fd = ::open(log_file.c_str(), O_RDONLY);
+	if (fd == -1) {
+		cout << "traffic log: unable to open " << log_file << ", what: " << strerror(errno) << "\n";
+		return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(MAGIC)) {
+		cout << "traffic log: " << log_file << " is not a traffic log\n";
+		::close(fd);
+		return;
+	}
+
+	void * data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);  // mapping is still valid
+
+	if (data == MAP_FAILED) {
+		cout << "traffic log: unable to map " << log_file << ", what: " << strerror(errno) << "\n";
+		return;
+	}
+
+	if (memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+		cout << "traffic log: " << log_file << " is not a traffic log\n";
+		munmap(data, st.st_size);
+		return;
+	}
+
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+	_data = static_cast<char *>(data);
+	_size = st.st_size;
+}
+
+traffic_log::~traffic_log() {
+	if (_data)
+		munmap(_data, _size);
+}
+
+bool traffic_log::is_open() const {
+	return _data != nullptr;
+}
+
+bool traffic_log::next(traffic_record & rec) {
+	if (!_data || _offset + RECORD_HEADER_SIZE > _size)
+		return false;
+
+	record_header header;
+	memcpy(&header, _data + _offset, sizeof(header));
+	if (_offset + RECORD_HEADER_SIZE + header.size > _size)
+		return false;  // truncated record (e.g. crashed recorder)
+
+	rec.timestamp = nanoseconds{header.timestamp};
+	rec.connection = header.connection;
+	rec.direction = (traffic_direction)header.direction;
+	rec.type = header.type;
+	rec.payload = string_view{_data + _offset + RECORD_HEADER_SIZE, header.size};
+
+	_offset += RECORD_HEADER_SIZE + header.size;
+	return true;
+}
+
+void traffic_log::rewind() {
+	_offset = sizeof(MAGIC);
+}
+
+}  // websocket
@@ -0,0 +1,75 @@
+/*! \file
+WebSocket traffic recording support (for offline benchmarking). */
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+#include <filesystem>
+#include <boost/noncopyable.hpp>
+
+namespace websocket {
+
+enum class traffic_direction : uint8_t {
+	inbound,  //!< client to server
+	outbound  //!< server to client
+};
+
+//! Recorded frame, payload points directly to the mapped log memory.
+struct traffic_record {
+	std::chrono::nanoseconds timestamp;  //!< since recording start
+	uint64_t connection;  //!< connection identifier (unique within recording, assigned in accept order from 1), 0 for broadcast (`send_all`)
+	traffic_direction direction;
+	uint8_t type;  //!< SoupWebsocketDataType value
+	std::string_view payload;
+};
+
+/*! Append only memory mapped binary traffic log writer.
+
+Log starts with 8 bytes magic followed by records, each record is 24 bytes
+header (timestamp, connection, payload size, direction, type) followed by
+payload. Mapping grows twice each time it gets full.
+
+\code
+traffic_recorder rec{"traffic.log"};
+server.set_recorder(&rec);
+\endcode
+\see traffic_log, server_channel::set_recorder() */
+class traffic_recorder : private boost::noncopyable {
+public:
+	explicit traffic_recorder(std::filesystem::path const & log_file, size_t initial_capacity = 1 << 20);
+	~traffic_recorder();
+	bool is_open() const;
+	void record(traffic_direction direction, uint64_t connection, uint8_t type, std::string_view payload);
+	size_t size() const;  //!< \return number of bytes written to log
+
+private:
+	bool reserve(size_t bytes);
+
+	int _fd;
+	char * _data;
+	size_t _capacity;
+	size_t _size;
+	std::chrono::steady_clock::time_point _start;
+};
+
+/*! Read only memory mapped binary traffic log reader.
+\code
+traffic_log log{"traffic.log"};
+for (traffic_record rec; log.next(rec);)
+	cout << rec.payload << "\n";
+\endcode */
+class traffic_log : private boost::noncopyable {
+public:
+	explicit traffic_log(std::filesystem::path const & log_file);
+	~traffic_log();
+	bool is_open() const;
+	bool next(traffic_record & rec);  //!< \return false in case there is no more record in the log
+	void rewind();
+
+private:
+	char * _data;
+	size_t _size;
+	size_t _offset;
+};
+
+}  // websocket
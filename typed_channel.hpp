@@ -0,0 +1,203 @@
+/*! \file
+Typed WebSocket channels, messages are encoded/decoded by a codec chosen at compile time.
+
+\code
+struct quote {
+	char symbol[8];
+	double bid, ask;
+};
+
+struct quote_server : public websocket::typed_server_channel<quote_server, quote, websocket::pod_codec<quote>> {
+	void on_message(quote const & q) {  // called directly by the base (no virtual dispatch)
+		send_all(q);
+	}
+};
+\endcode */
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include "websocket.hpp"
+
+namespace websocket {
+
+/*! Codec for trivially copyable types, message is sent as binary copy of the object.
+\note both sides needs to share the same architecture (byte order, alignment). */
+template <typename T>
+struct pod_codec {
+	static_assert(std::is_trivially_copyable_v<T>, "trivially copyable type expected");
+
+	static constexpr SoupWebsocketDataType data_type = SOUP_WEBSOCKET_DATA_BINARY;
+
+	static bool decode(std::string_view buf, T & msg) {
+		if (buf.size() != sizeof(T))
+			return false;
+		memcpy(&msg, buf.data(), sizeof(T));
+		return true;
+	}
+
+	static void encode(T const & msg, std::string & buf) {
+		buf.assign(reinterpret_cast<char const *>(&msg), sizeof(T));
+	}
+};
+
+/*! Codec for messages composed of fields, each field is sent as varint length followed by
+field bytes. Decoded fields points directly to received buffer (no copy).
+\note decoded fields are valid only during `on_message()` call */
+struct length_prefixed_codec {
+	using message_type = std::vector<std::string_view>;
+
+	static constexpr SoupWebsocketDataType data_type = SOUP_WEBSOCKET_DATA_BINARY;
+
+	static bool decode(std::string_view buf, message_type & msg) {
+		msg.clear();  // capacity is reused
+		while (!buf.empty()) {
+			uint64_t size = 0;
+			unsigned shift = 0;
+			for (bool more = true; more; shift += 7) {
+				if (buf.empty() || shift >= 64)
+					return false;
+				uint8_t const b = uint8_t(buf.front());
+				buf.remove_prefix(1);
+				size |= uint64_t(b & 0x7f) << shift;
+				more = b & 0x80;
+			}
+
+			if (size > buf.size())
+				return false;
+
+			msg.push_back(buf.substr(0, size));
+			buf.remove_prefix(size);
+		}
+		return true;
+	}
+
+	static void encode(message_type const & msg, std::string & buf) {
+		buf.clear();  // capacity is reused
+		for (std::string_view field : msg) {
+			uint64_t size = field.size();
+			while (size >= 0x80) {
+				buf.push_back(char(size | 0x80));
+				size >>= 7;
+			}
+			buf.push_back(char(size));
+			buf.append(field.data(), field.size());
+		}
+	}
+};
+
+/*! JSON codec, message is sent as text. There is no JSON library dependency, so `T` needs to
+provide (ADL visible) serialization functions
+
+\code
+bool from_json(std::string_view json, T & msg);
+void to_json(T const & msg, std::string & json);
+\endcode */
+template <typename T>
+struct json_codec {
+	static constexpr SoupWebsocketDataType data_type = SOUP_WEBSOCKET_DATA_TEXT;
+
+	static bool decode(std::string_view buf, T & msg) {
+		return from_json(buf, msg);
+	}
+
+	static void encode(T const & msg, std::string & buf) {
+		buf.clear();  // capacity is reused
+		to_json(msg, buf);
+	}
+};
+
+namespace detail {
+
+//! Decodes received message with codec into reusable message.
+template <typename Msg, typename Codec>
+bool typed_decode(SoupWebsocketDataType data_type, std::string_view buf, Msg & msg) {
+	if (data_type != Codec::data_type) {
+		std::cout << "websocket: unexpected message type received, ignored\n";
+		return false;
+	}
+
+	if (!Codec::decode(buf, msg)) {
+		std::cout << "websocket: unable to decode message, ignored\n";
+		return false;
+	}
+
+	return true;
+}
+
+}  // detail
+
+/*! Typed WebSocket client channel (CRTP), decoded messages are passed to `Derived::on_message(Msg const &)`
+which needs to be accessible from the base (public or base declared as friend).
+\tparam Derived channel implementation
+\tparam Msg message type
+\tparam Codec message codec (see pod_codec, length_prefixed_codec, json_codec) */
+template <typename Derived, typename Msg, typename Codec>
+class typed_client_channel : public client_channel {
+public:
+	using message_type = Msg;
+	using codec_type = Codec;
+	using client_channel::client_channel;  // reuse constructors
+	using client_channel::send;
+
+	void send(Msg const & msg) {
+		Codec::encode(msg, _send_buf);
+		if constexpr (Codec::data_type == SOUP_WEBSOCKET_DATA_TEXT)
+			client_channel::send(_send_buf);
+		else
+			send_binary(_send_buf);
+	}
+
+private:
+	void on_message(std::string_view msg) final {
+		if (detail::typed_decode<Msg, Codec>(SOUP_WEBSOCKET_DATA_TEXT, msg, _recv_msg))
+			static_cast<Derived *>(this)->on_message(_recv_msg);
+	}
+
+	void on_binary_message(std::string_view msg) final {
+		if (detail::typed_decode<Msg, Codec>(SOUP_WEBSOCKET_DATA_BINARY, msg, _recv_msg))
+			static_cast<Derived *>(this)->on_message(_recv_msg);
+	}
+
+	std::string _send_buf;  //!< reusable buffers
+	Msg _recv_msg;
+};
+
+/*! Typed WebSocket server channel (CRTP).
+\see typed_client_channel */
+template <typename Derived, typename Msg, typename Codec>
+class typed_server_channel : public server_channel {
+public:
+	using message_type = Msg;
+	using codec_type = Codec;
+	using server_channel::server_channel;  // reuse constructors
+	using server_channel::send_all;
+
+	void send_all(Msg const & msg) {
+		Codec::encode(msg, _send_buf);
+		if constexpr (Codec::data_type == SOUP_WEBSOCKET_DATA_TEXT)
+			server_channel::send_all(_send_buf);
+		else
+			send_all_binary(_send_buf);
+	}
+
+private:
+	void on_message(std::string_view msg) final {
+		if (detail::typed_decode<Msg, Codec>(SOUP_WEBSOCKET_DATA_TEXT, msg, _recv_msg))
+			static_cast<Derived *>(this)->on_message(_recv_msg);
+	}
+
+	void on_binary_message(std::string_view msg) final {
+		if (detail::typed_decode<Msg, Codec>(SOUP_WEBSOCKET_DATA_BINARY, msg, _recv_msg))
+			static_cast<Derived *>(this)->on_message(_recv_msg);
+	}
+
+	std::string _send_buf;  //!< reusable buffers
+	Msg _recv_msg;
+};
+
+}  // websocket
@@ -0,0 +1,259 @@
+#include <string_view>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <gio/gunixsocketaddress.h>
+#include "unix_socket.hpp"
+
+using std::string, std::string_view;
+
+namespace websocket {
+
+namespace detail {
+
+namespace {
+
+constexpr size_t MAX_RESPONSE_SIZE = 8192;
+
+//! Client handshake state, deleted when handshake is done.
+struct handshake {
+	GCancellable * cancellable;
+	GSocketConnection * connection;
+	SoupMessage * request;
+	string data;  //!< serialized request, then received response
+	char byte;  //!< response is read byte by byte so we do not read any WebSocket frame
+	unix_connected_handler handler;
+
+	~handshake() {
+		if (cancellable)
+			g_object_unref(cancellable);
+		if (connection)
+			g_object_unref(connection);
+		if (request)
+			g_object_unref(request);
+	}
+
+	void fail(string const & what) {
+		handler(nullptr, what);
+		delete this;
+	}
+};
+
+//! \return true in case of error, cancelled handshake is deleted without calling handler
+bool failed(handshake * hs, GError * error) {
+	if (!error)
+		return false;
+
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		delete hs;
+	else
+		hs->fail(error->message);
+
+	g_error_free(error);
+	return true;
+}
+
+void read_response_byte(handshake * hs);
+
+void response_read_cb(GObject * source, GAsyncResult * res, gpointer user_data) {
+	handshake * hs = static_cast<handshake *>(user_data);
+	GError * error = nullptr;
+	gssize const n = g_input_stream_read_finish(G_INPUT_STREAM(source), res, &error);
+	if (failed(hs, error))
+		return;
+
+	if (n == 0) {
+		hs->fail("connection closed during handshake");
+		return;
+	}
+
+	hs->data.push_back(hs->byte);
+	if (size(hs->data) < 4 || string_view{hs->data}.substr(size(hs->data) - 4) != "\r\n\r\n") {
+		if (size(hs->data) > MAX_RESPONSE_SIZE)
+			hs->fail("handshake response too large");
+		else
+			read_response_byte(hs);
+		return;
+	}
+
+	// response complete
+	SoupHTTPVersion version;
+	guint status = 0;
+	char * reason = nullptr;
+	if (!soup_headers_parse_response(hs->data.c_str(), size(hs->data), hs->request->response_headers,
+		&version, &status, &reason)) {
+		hs->fail("malformed handshake response");
+		return;
+	}
+
+	soup_message_set_status_full(hs->request, status, reason);
+	g_free(reason);
+
+	if (!soup_websocket_client_verify_handshake(hs->request, &error)) {
+		hs->fail(error->message);
+		g_error_free(error);
+		return;
+	}
+
+	hs->handler(G_IO_STREAM(hs->connection), string{});
+	delete hs;
+}
+
+void read_response_byte(handshake * hs) {
+	GInputStream * in = g_io_stream_get_input_stream(G_IO_STREAM(hs->connection));
+	g_input_stream_read_async(in, &hs->byte, 1, G_PRIORITY_DEFAULT, hs->cancellable,
+		response_read_cb, hs);
+}
+
+void request_written_cb(GObject * source, GAsyncResult * res, gpointer user_data) {
+	handshake * hs = static_cast<handshake *>(user_data);
+	GError * error = nullptr;
+	g_output_stream_write_all_finish(G_OUTPUT_STREAM(source), res, nullptr, &error);
+	if (failed(hs, error))
+		return;
+
+	hs->data.clear();
+	read_response_byte(hs);
+}
+
+void append_header(char const * name, char const * value, gpointer user_data) {
+	string & data = *static_cast<string *>(user_data);
+	data += name;
+	data += ": ";
+	data += value;
+	data += "\r\n";
+}
+
+void connected_cb(GObject * source, GAsyncResult * res, gpointer user_data) {
+	handshake * hs = static_cast<handshake *>(user_data);
+	GError * error = nullptr;
+	hs->connection = g_socket_client_connect_finish(G_SOCKET_CLIENT(source), res, &error);
+	if (failed(hs, error))
+		return;
+
+	// serialize upgrade request (libsoup session can not send request over Unix socket)
+	soup_websocket_client_prepare_handshake(hs->request, nullptr, nullptr);
+	SoupURI * uri = soup_message_get_uri(hs->request);
+	hs->data = string{"GET "} + soup_uri_get_path(uri) + " HTTP/1.1\r\n"
+		"Host: localhost\r\n";
+	soup_message_headers_foreach(hs->request->request_headers, append_header, &hs->data);
+	hs->data += "\r\n";
+
+	GOutputStream * out = g_io_stream_get_output_stream(G_IO_STREAM(hs->connection));
+	g_output_stream_write_all_async(out, hs->data.data(), size(hs->data), G_PRIORITY_DEFAULT,
+		hs->cancellable, request_written_cb, hs);
+}
+
+//! \return 0 if somebody is listening on `socket_path`, otherwise connect error (errno)
+int socket_state(string const & socket_path) {
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (size(socket_path) >= sizeof(addr.sun_path))
+		return ENAMETOOLONG;
+	memcpy(addr.sun_path, socket_path.c_str(), size(socket_path) + 1);
+
+	int const fd = ::socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	if (fd == -1)
+		return errno;
+
+	int const result = ::connect(fd, reinterpret_cast<sockaddr const *>(&addr), sizeof(addr)) == 0 ? 0 : errno;
+	::close(fd);
+	return result;
+}
+
+}  // namespace
+
+GSocketAddress * unix_socket_address(string const & socket_path) {
+	if (!socket_path.empty() && socket_path[0] == '@')  // Linux abstract namespace
+		return g_unix_socket_address_new_with_type(socket_path.c_str() + 1, socket_path.size() - 1,
+			G_UNIX_SOCKET_ADDRESS_ABSTRACT);
+	else
+		return g_unix_socket_address_new(socket_path.c_str());
+}
+
+GSocket * unix_listen_socket(string const & socket_path, GError ** error) {
+	// remove stale socket file from previous run, but never take the path from a live server
+	struct stat st;
+	if (socket_path[0] != '@' && stat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+		switch (socket_state(socket_path)) {
+			case ECONNREFUSED:  // nobody is listening
+				unlink(socket_path.c_str());
+				break;
+
+			case 0:
+				g_set_error(error, G_IO_ERROR, G_IO_ERROR_ADDRESS_IN_USE, "%s is used by another server",
+					socket_path.c_str());
+				return nullptr;
+
+			default:
+				break;  // let bind report the problem
+		}
+	}
+
+	GSocket * sock = g_socket_new(G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, error);
+	if (!sock)
+		return nullptr;
+
+	GSocketAddress * addr = unix_socket_address(socket_path);
+	bool const listening = g_socket_bind(sock, addr, FALSE, error) && g_socket_listen(sock, error);
+	g_object_unref(addr);
+
+	if (!listening) {
+		g_object_unref(sock);
+		return nullptr;
+	}
+
+	return sock;
+}
+
+unix_socket_file unix_listen_socket_file(string const & socket_path) {
+	struct stat st;
+	if (socket_path.empty() || socket_path[0] == '@' || stat(socket_path.c_str(), &st) != 0)
+		return unix_socket_file{string{}, 0, 0};
+
+	return unix_socket_file{socket_path, uint64_t(st.st_dev), uint64_t(st.st_ino)};
+}
+
+void remove_unix_socket_file(unix_socket_file const & file) {
+	if (file.path.empty())
+		return;
+
+	struct stat st;
+	if (stat(file.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)
+		&& uint64_t(st.st_dev) == file.device && uint64_t(st.st_ino) == file.inode)
+		unlink(file.path.c_str());
+}
+
+void unix_connect_async(string const & socket_path, string const & path, GCancellable * cancellable,
+	unix_connected_handler && handler) {
+
+	assert(cancellable);
+
+	handshake * hs = new handshake{
+		G_CANCELLABLE(g_object_ref(cancellable)),
+		nullptr,
+		soup_message_new(SOUP_METHOD_GET, ("ws://localhost" + path).c_str()),
+		string{},
+		0,
+		move(handler)
+	};
+
+	if (!hs->request) {
+		hs->fail("invalid path \"" + path + "\"");
+		return;
+	}
+
+	GSocketAddress * addr = unix_socket_address(socket_path);
+	GSocketClient * client = g_socket_client_new();
+	g_socket_client_connect_async(client, G_SOCKET_CONNECTABLE(addr), cancellable, connected_cb, hs);
+	g_object_unref(client);  // async operation keeps its own reference
+	g_object_unref(addr);
+}
+
+}  // detail
+
+}  // websocket
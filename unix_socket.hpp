@@ -0,0 +1,44 @@
+/*! \file
+Unix domain socket support (listening socket and client WebSocket handshake). */
+#pragma once
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <libsoup/soup.h>
+
+namespace websocket {
+
+namespace detail {
+
+/*! \param[in] socket_path socket file path or abstract socket name prefixed with '@' (e.g. "@echo")
+\return new socket address */
+GSocketAddress * unix_socket_address(std::string const & socket_path);
+
+/*! Stale socket file (nobody listening) from previous run is removed, socket file used by a
+running server is kept and the function fails.
+\return bound and listening socket or nullptr in case of error */
+GSocket * unix_listen_socket(std::string const & socket_path, GError ** error);
+
+//! Socket file of a listening socket, identified by inode (path can be taken over by another server).
+struct unix_socket_file {
+	std::string path;  //!< empty for abstract socket or if there is no socket file
+	uint64_t device, inode;
+};
+
+//! \return socket file created by unix_listen_socket() for `socket_path`
+unix_socket_file unix_listen_socket_file(std::string const & socket_path);
+
+//! Removes socket file unless it was replaced by another server socket in the meantime.
+void remove_unix_socket_file(unix_socket_file const & file);
+
+//! \param[in] stream connected stream after successful handshake or nullptr in case of error
+using unix_connected_handler = std::function<void (GIOStream * stream, std::string const & error)>;
+
+/*! Connects to Unix domain socket and performs WebSocket (HTTP upgrade) handshake for `path`
+resource. Handler is not called if operation is cancelled. */
+void unix_connect_async(std::string const & socket_path, std::string const & path,
+	GCancellable * cancellable, unix_connected_handler && handler);
+
+}  // detail
+
+}  // websocket
@@ -2,9 +2,16 @@
 #include <string_view>
 #include <iostream>
 #include <cassert>
+#include <sys/socket.h>
 #include "websocket.hpp"
+#include "traffic_recorder.hpp"
+#include "last_value_cache.hpp"
+#include "delta_codec.hpp"
+#include "frame_kernels.hpp"
+#include "unix_socket.hpp"
 
 using std::string_view, std::string, std::cout;
+using std::chrono::milliseconds;
 using std::filesystem::exists, std::filesystem::path;
 
 namespace websocket {
@@ -12,12 +19,26 @@ namespace websocket {
 namespace detail {
 
 void on_close(SoupWebsocketConnection * conn, gpointer data);
+GSocket * reuse_port_socket(int port, GError ** error);  //!< \return bound and listening socket or nullptr
+void attach_timeout(GSource *& source, milliseconds interval, GSourceFunc func, gpointer data);
+void destroy_source(GSource *& source);
 
 }  // detail
 
+namespace {
+
+//! libsoup refuses to send to closing connections (e.g. during drain), so broadcasts skip them
+bool is_open(SoupWebsocketConnection * connection) {
+	return soup_websocket_connection_get_state(connection) == SOUP_WEBSOCKET_STATE_OPEN;
+}
+
+}  // namespace
+
 client_channel::client_channel()
 	: _sess{nullptr}
 	, _conn{nullptr}
+	, _unix_connect{nullptr}
+	, _delta{false}
 {
 	_sess = soup_session_new();
 	assert(_sess);
@@ -26,6 +47,8 @@ client_channel::client_channel()
 client_channel::client_channel(path const & ssl_cert_file)
 	: _sess{nullptr}
 	, _conn{nullptr}
+	, _unix_connect{nullptr}
+	, _delta{false}
 {
 	assert(exists(ssl_cert_file));
 
@@ -41,6 +64,11 @@ client_channel::client_channel(path const & ssl_cert_file)
 }
 
 client_channel::~client_channel() {
+	if (_unix_connect) {
+		g_cancellable_cancel(_unix_connect);  // handler is not called for cancelled connection
+		g_clear_object(&_unix_connect);
+	}
+
 	if (_conn)
 		g_clear_object(&_conn);  // this will not call closed handler
 
@@ -63,9 +91,46 @@ void client_channel::connect(string const & address, connected_handler && handle
 	g_object_unref(G_OBJECT(msg));
 }
 
+void client_channel::connect(GIOStream * stream, connected_handler && handler) {
+	assert(stream && !_conn);
+
+	_address.clear();  // there is nothing to reconnect to
+	_connected_handler = move(handler);
+
+	SoupURI * uri = soup_uri_new("ws://loopback/");
+	_conn = soup_websocket_connection_new(stream, uri, SOUP_WEBSOCKET_CONNECTION_CLIENT, nullptr, nullptr);
+	soup_uri_free(uri);
+
+	connection_established();
+}
+
+void client_channel::connect_unix(string const & socket_path, string const & path,
+	connected_handler && handler) {
+
+	assert(!_conn && !_unix_connect);
+
+	_unix_connect = g_cancellable_new();
+	detail::unix_connect_async(socket_path, path, _unix_connect,
+		[this, socket_path, handler = move(handler)](GIOStream * stream, string const & error) mutable {
+			g_clear_object(&_unix_connect);
+
+			if (!stream) {
+				cout << "websocket: unable connect to \"" << socket_path << "\" socket, what: " << error << "\n";
+				return;
+			}
+
+			connect(stream, move(handler));
+		});
+}
+
 void client_channel::reconnect() {
 	assert(_sess);
 
+	if (_address.empty()) {
+		cout << "websocket: stream channel can not be reconnected\n";
+		return;
+	}
+
 	if (_conn)
 		g_clear_object(&_conn);  // this close connection without calling closed handler
 
@@ -82,6 +147,23 @@ void client_channel::send(string const & msg) {
 	soup_websocket_connection_send_text(_conn, msg.c_str());
 }
 
+void client_channel::send_binary(string_view msg) {
+	assert(_conn);
+	soup_websocket_connection_send_binary(_conn, msg.data(), msg.size());
+}
+
+void client_channel::on_binary_message(string_view msg) {
+	cout << "websocket: unknown binary message received, ignored\n";
+}
+
+void client_channel::enable_priority_lanes() {
+	_lanes = std::make_unique<detail::lane_reassembler>();
+}
+
+void client_channel::enable_delta() {
+	_delta = true;
+}
+
 void client_channel::connection_handler(GAsyncResult * res) {
 	assert(!_conn);
 
@@ -95,6 +177,16 @@ void client_channel::connection_handler(GAsyncResult * res) {
 	}
 	assert(_conn);
 
+	connection_established();
+}
+
+void client_channel::connection_established() {
+	assert(_conn);
+
+	_baselines.clear();  // new connection starts with keyframes
+	if (_lanes)  // partially reassembled messages belong to the previous connection
+		_lanes = std::make_unique<detail::lane_reassembler>();
+
 	// handle signals
 	g_signal_connect(_conn, "message", G_CALLBACK(message_handler_cb), this);
 	g_signal_connect(_conn, "closed", G_CALLBACK(closed_handler_cb), this);
@@ -105,7 +197,23 @@ void client_channel::connection_handler(GAsyncResult * res) {
 void client_channel::message_handler(SoupWebsocketDataType data_type, GBytes const * message) {
 	switch (data_type) {
 		case SOUP_WEBSOCKET_DATA_BINARY: {
-			cout << "websocket: unknown binary message received, ignored\n";
+			gsize size = 0;
+			gchar * data = (gchar *)g_bytes_get_data((GBytes *)message, &size);
+			if (_delta)  // binary messages are used for delta frames
+				delta_message_handler(string_view{data, size});
+			else if (_lanes) {  // binary messages are used for fragments
+				SoupWebsocketDataType type;
+				string_view payload;
+				if (!_lanes->feed(string_view{data, size}, type, payload))
+					return;  // incomplete message
+
+				if (type == SOUP_WEBSOCKET_DATA_TEXT)
+					on_message(payload);
+				else
+					on_binary_message(payload);
+			}
+			else
+				on_binary_message(string_view{data, size});
 			return;
 		}
 
@@ -122,10 +230,64 @@ void client_channel::message_handler(SoupWebsocketDataType data_type, GBytes con
 	}
 }
 
+void client_channel::delta_message_handler(string_view msg) {
+	if (size(msg) < 2 || size(msg) < 2u + uint8_t(msg[1])) {
+		cout << "websocket: malformed delta message received, ignored\n";
+		return;
+	}
+
+	delta_tag const tag = (delta_tag)msg[0];
+	string_view const key = msg.substr(2, uint8_t(msg[1]));
+	msg.remove_prefix(2 + size(key));
+
+	string * baseline = nullptr;
+	switch (tag) {
+		case delta_tag::keyframe: {
+			auto it = _baselines.find(key);
+			if (it == end(_baselines))
+				it = _baselines.emplace(string{key}, string{}).first;
+			baseline = &it->second;
+			baseline->assign(msg.data(), msg.size());
+			break;
+		}
+
+		case delta_tag::delta: {
+			auto it = _baselines.find(key);
+			if (it == end(_baselines)) {
+				cout << "websocket: delta message received before keyframe, ignored\n";
+				return;
+			}
+
+			baseline = &it->second;
+			if (!delta_decode(*baseline, msg, _reconstructed)) {
+				cout << "websocket: malformed delta message received, waiting for keyframe\n";
+				_baselines.erase(it);  // baseline is out of date now
+				return;
+			}
+
+			swap(*baseline, _reconstructed);
+			break;
+		}
+
+		default:
+			cout << "websocket: unknown binary message received, ignored\n";
+			return;
+	}
+
+	// reconstructed message is passed as text, but libsoup validates only text frames
+	if (!valid_utf8(*baseline)) {
+		cout << "websocket: reconstructed delta message is not valid UTF-8 text, ignored\n";
+		return;
+	}
+
+	on_message(*baseline);
+}
+
 void client_channel::closed_handler() {
 	assert(_conn);
 	g_clear_object(&_conn);
 	assert(!_conn);
+	on_closed();
 }
 
 void client_channel::connection_handler_cb(SoupSession *, GAsyncResult * res,
@@ -149,10 +311,24 @@ void client_channel::closed_handler_cb(SoupWebsocketConnection * conn, gpointer
 server_channel::server_channel()
 	: _cert{nullptr}
 	, _server{nullptr}
+	, _socket_file{}
+	, _recorder{nullptr}
+	, _next_connection_id{1}  // 0 is used for broadcast
+	, _lanes_fragment_size{0}
+	, _draining{false}
+	, _drain_step{nullptr}
+	, _drain_deadline{nullptr}
 {}
 
 server_channel::server_channel(path const & ssl_cert_file, path const & ssl_key_file)
-	: _server{nullptr} {
+	: _server{nullptr}
+	, _socket_file{}
+	, _recorder{nullptr}
+	, _next_connection_id{1}  // 0 is used for broadcast
+	, _lanes_fragment_size{0}
+	, _draining{false}
+	, _drain_step{nullptr}
+	, _drain_deadline{nullptr} {
 	assert(exists(ssl_cert_file) && exists(ssl_key_file));
 
 	// load certificate
@@ -169,17 +345,71 @@ server_channel::server_channel(path const & ssl_cert_file, path const & ssl_key_
 server_channel::~server_channel() {
 	assert(!_cert);
 
+	detail::destroy_source(_drain_step);
+	detail::destroy_source(_drain_deadline);
+	_lanes.clear();  // lanes needs to be destroyed before connections
+
 	// free connections
 	for_each(begin(_clients), end(_clients), [](SoupWebsocketConnection * client){
 		g_object_unref(G_OBJECT(client));
 	});
 
-	soup_server_disconnect(_server);
-	g_object_unref(G_OBJECT(_server));
+	if (_server) {  // not created for loopback only channel
+		soup_server_disconnect(_server);
+		g_object_unref(G_OBJECT(_server));
+	}
+
+	detail::remove_unix_socket_file(_socket_file);
+}
+
+bool server_channel::listen(int port, string const & path, bool reuse_port) {
+	SoupServerListenOptions options = (SoupServerListenOptions)0;
+	if (!create_server(path, options))
+		return false;
+
+	if (!reuse_port)
+		return soup_server_listen_all(_server, port, options, nullptr) == TRUE;
+
+	GError * error = nullptr;
+	GSocket * sock = detail::reuse_port_socket(port, &error);
+	bool const listening = sock && soup_server_listen_socket(_server, sock, options, &error);
+	if (sock)
+		g_object_unref(sock);  // server keeps its own reference
+
+	if (error) {
+		cout << "websocket: unable to listen on " << port << " port, what: " << error->message << "\n";
+		g_error_free(error);
+	}
+
+	return listening;
 }
 
-bool server_channel::listen(int port, string const & path) {
+bool server_channel::listen_unix(string const & socket_path, string const & path) {
 	SoupServerListenOptions options = (SoupServerListenOptions)0;
+	if (!create_server(path, options))
+		return false;
+
+	GError * error = nullptr;
+	GSocket * sock = detail::unix_listen_socket(socket_path, &error);
+	bool const listening = sock && soup_server_listen_socket(_server, sock, options, &error);
+	if (sock)
+		g_object_unref(sock);  // server keeps its own reference
+
+	if (error) {
+		cout << "websocket: unable to listen on \"" << socket_path << "\" socket, what: " << error->message << "\n";
+		g_error_free(error);
+	}
+
+	if (listening)
+		_socket_file = detail::unix_listen_socket_file(socket_path);
+
+	return listening;
+}
+
+bool server_channel::create_server(string const & path, SoupServerListenOptions & options) {
+	assert(!_server && "server already created");
+
+	options = (SoupServerListenOptions)0;
 	if (_cert) {  // create secure connection
 		_server = soup_server_new(SOUP_SERVER_SERVER_HEADER, "WebSocket Secure server",
 			SOUP_SERVER_TLS_CERTIFICATE, _cert, nullptr);
@@ -194,22 +424,299 @@ bool server_channel::listen(int port, string const & path) {
 
 	assert(_server);
 	soup_server_add_websocket_handler(_server, path.c_str(), nullptr, nullptr, websocket_handler_cb, (gpointer)this, nullptr);
-	return soup_server_listen_all(_server, port, options, nullptr) == TRUE;
+	return true;
+}
+
+void server_channel::accept(GIOStream * stream) {
+	assert(stream);
+
+	SoupURI * uri = soup_uri_new("ws://loopback/");
+	SoupWebsocketConnection * connection = soup_websocket_connection_new(stream, uri,
+		SOUP_WEBSOCKET_CONNECTION_SERVER, nullptr, nullptr);
+	soup_uri_free(uri);
+
+	// the same way as connection accepted by libsoup server, which release its reference after the handler
+	websocket_handler_cb(_server, connection, nullptr, nullptr, this);
+	g_object_unref(G_OBJECT(connection));
 }
 
 void server_channel::send_all(string const & msg) {
+	if (_recorder)  // broadcast is recorded once with 0 connection
+		_recorder->record(traffic_direction::outbound, 0, SOUP_WEBSOCKET_DATA_TEXT, msg);
+
+	if (_delta) {
+		send_all_delta(string_view{}, msg);  // default stream
+		return;
+	}
+
+	send_all_text(msg);
+}
+
+void server_channel::send_all_text(string const & msg) {
+	if (_lanes_fragment_size > 0) {
+		send_all_lanes(msg, SOUP_WEBSOCKET_DATA_TEXT, priority::normal);
+		return;
+	}
+
 	for (SoupWebsocketConnection * client : _clients)
-		soup_websocket_connection_send_text(client, msg.c_str());  // TOOD: we can maybe call `soup_websocket_connection_send_binary` instead of text version which would allow us to use string_view instead string
+		if (is_open(client))
+			soup_websocket_connection_send_text(client, msg.c_str());  // TOOD: we can maybe call `soup_websocket_connection_send_binary` instead of text version which would allow us to use string_view instead string
+}
+
+void server_channel::send_all_binary(string_view msg) {
+	if (_recorder)
+		_recorder->record(traffic_direction::outbound, 0, SOUP_WEBSOCKET_DATA_BINARY, msg);
+
+	if (_lanes_fragment_size > 0) {
+		send_all_lanes(msg, SOUP_WEBSOCKET_DATA_BINARY, priority::normal);
+		return;
+	}
+
+	for (SoupWebsocketConnection * client : _clients)
+		if (is_open(client))
+			soup_websocket_connection_send_binary(client, msg.data(), msg.size());
+}
+
+void server_channel::send_all(string const & msg, priority prio) {
+	if (_lanes_fragment_size == 0 || _delta) {
+		send_all(msg);
+		return;
+	}
+
+	if (_recorder)
+		_recorder->record(traffic_direction::outbound, 0, SOUP_WEBSOCKET_DATA_TEXT, msg);
+
+	send_all_lanes(msg, SOUP_WEBSOCKET_DATA_TEXT, prio);
+}
+
+void server_channel::enable_priority_lanes(size_t fragment_size) {
+	assert(fragment_size > 0);
+	_lanes_fragment_size = fragment_size;
+}
+
+void server_channel::send_all_lanes(string_view msg, SoupWebsocketDataType type, priority prio) {
+	assert(_lanes_fragment_size > 0);
+
+	// message data are shared by all client queues
+	auto const data = std::make_shared<string const>(msg);
+	for (SoupWebsocketConnection * client : _clients) {
+		if (!is_open(client))
+			continue;
+
+		auto & lanes = _lanes[client];
+		if (!lanes)
+			lanes = std::make_unique<detail::outbound_lanes>(client, _lanes_fragment_size);
+		lanes->push(prio, data, type);
+	}
+}
+
+void server_channel::drain(milliseconds deadline, drained_handler && handler) {
+	assert(!_draining && "channel already draining");
+	_draining = true;
+	_drained_handler = move(handler);
+
+	if (_server)  // stop accepting new connections, already upgraded WebSocket connections are not affected
+		soup_server_disconnect(_server);
+
+	cout << "websocket: draining " << size(_clients) << " connection(s)\n";
+
+	if (_clients.empty()) {
+		drain_done();
+		return;
+	}
+
+	if (drain_step())  // some clients still have something to send
+		detail::attach_timeout(_drain_step, milliseconds{10}, drain_step_cb, this);
+
+	detail::attach_timeout(_drain_deadline, deadline, drain_deadline_cb, this);
+}
+
+bool server_channel::draining() const {
+	return _draining;
+}
+
+bool server_channel::drain_step() {
+	bool pending = false;
+	for (SoupWebsocketConnection * client : _clients) {
+		if (!is_open(client))
+			continue;  // already closing
+
+		auto lanes = _lanes.find(client);
+		bool const lanes_flushed = lanes == end(_lanes) || lanes->second->empty();
+
+		// close frame is queued as urgent by libsoup so we need to wait for send queue to be flushed
+		if (lanes_flushed && detail::output_flushed(client))
+			soup_websocket_connection_close(client, SOUP_WEBSOCKET_CLOSE_GOING_AWAY, "server going away");
+		else
+			pending = true;
+	}
+	return pending;
+}
+
+void server_channel::drain_done() {
+	detail::destroy_source(_drain_step);
+	detail::destroy_source(_drain_deadline);
+
+	cout << "websocket: drained\n";
+
+	if (_drained_handler) {
+		drained_handler handler = move(_drained_handler);
+		_drained_handler = nullptr;
+		handler();
+	}
+}
+
+void server_channel::drop_client(SoupWebsocketConnection * connection) {
+	auto it = _clients.find(connection);
+	assert(it != end(_clients));
+
+	cout << "websocket: connection " << static_cast<void *>(connection) << " dropped\n";
+
+	g_signal_handlers_disconnect_by_data(connection, this);  // we do not want closed handler to be called
+	g_io_stream_close(soup_websocket_connection_get_io_stream(connection), nullptr, nullptr);
+
+	if (_delta)
+		for (auto & [key, stream] : _delta->streams)
+			stream.synced.erase(connection);
+
+	_lanes.erase(connection);
+	_connection_ids.erase(connection);
+	_clients.erase(it);
+	g_object_unref(G_OBJECT(connection));
+}
+
+void server_channel::send_all(string const & key, string const & msg) {
+	if (_snapshot)
+		_snapshot->update(key, msg);
+
+	if (!_delta) {
+		send_all(msg);
+		return;
+	}
+
+	if (_recorder)
+		_recorder->record(traffic_direction::outbound, 0, SOUP_WEBSOCKET_DATA_TEXT, msg);
+
+	if (size(key) <= 255)
+		send_all_delta(key, msg);
+	else  // key does not fit delta frame header, sent as plain text so the default stream stays untouched
+		send_all_text(msg);
+}
+
+void server_channel::enable_snapshot(size_t max_bytes) {
+	_snapshot = std::make_unique<last_value_cache>(max_bytes);
+}
+
+void server_channel::enable_delta(size_t keyframe_interval) {
+	_delta = std::make_unique<delta_mode>();
+	_delta->keyframe_interval = keyframe_interval;  // already connected clients are not synced, they get keyframe first
+}
+
+void server_channel::send_all_delta(string_view key, string const & msg) {
+	assert(_delta && size(key) <= 255);
+
+	auto it = _delta->streams.find(key);
+	if (it == end(_delta->streams))
+		it = _delta->streams.emplace(string{key}, delta_stream{0, string{}, {}}).first;
+
+	delta_stream & d = it->second;
+
+	// frame header: tag, key size, key
+	auto start_frame = [key](string & frame, delta_tag tag){
+		frame.assign(1, (char)tag);
+		frame.push_back(char(size(key)));
+		frame.append(key.data(), key.size());
+	};
+
+	// delta is computed once for all synced clients
+	bool send_delta = d.since_keyframe < _delta->keyframe_interval && !d.synced.empty();
+	if (send_delta) {
+		start_frame(_delta->delta, delta_tag::delta);
+		size_t const header_size = size(_delta->delta);
+		delta_encode(d.baseline, msg, _delta->delta);
+		send_delta = size(_delta->delta) < size(msg) + header_size;  // delta is not worth it otherwise
+	}
+
+	if (send_delta)
+		++d.since_keyframe;
+	else {  // keyframe for everyone
+		d.synced.clear();
+		d.since_keyframe = 0;
+	}
+
+	bool keyframe_ready = false;
+	for (SoupWebsocketConnection * client : _clients) {
+		if (!is_open(client))
+			continue;  // closing
+
+		if (send_delta && d.synced.count(client)) {
+			soup_websocket_connection_send_binary(client, data(_delta->delta), size(_delta->delta));
+			continue;
+		}
+
+		if (!keyframe_ready) {
+			start_frame(_delta->keyframe, delta_tag::keyframe);
+			_delta->keyframe.append(msg);
+			keyframe_ready = true;
+		}
+
+		soup_websocket_connection_send_binary(client, data(_delta->keyframe), size(_delta->keyframe));
+		d.synced.insert(client);
+	}
+
+	d.baseline = msg;
+}
+
+void server_channel::set_recorder(traffic_recorder * recorder) {
+	_recorder = recorder;
 }
 
 void server_channel::on_message(string_view msg) {}
 
+void server_channel::on_binary_message(string_view msg) {
+	cout << "websocket: unknown binary message received, ignored\n";
+}
+
+void server_channel::on_binary_message(SoupWebsocketConnection * connection, string_view msg) {
+	on_binary_message(msg);
+}
+
+void server_channel::send_binary(SoupWebsocketConnection * connection, string_view msg) {
+	assert(connection);
+
+	if (!is_open(connection))
+		return;
+
+	if (_recorder)
+		_recorder->record(traffic_direction::outbound, _connection_ids[connection],
+			SOUP_WEBSOCKET_DATA_BINARY, msg);
+
+	if (_lanes_fragment_size > 0) {  // keep order with messages already queued in lanes
+		auto & lanes = _lanes[connection];
+		if (!lanes)
+			lanes = std::make_unique<detail::outbound_lanes>(connection, _lanes_fragment_size);
+		lanes->push(priority::normal, std::make_shared<string const>(msg), SOUP_WEBSOCKET_DATA_BINARY);
+		return;
+	}
+
+	soup_websocket_connection_send_binary(connection, msg.data(), msg.size());
+}
+
 void server_channel::message_handler(SoupWebsocketConnection * connection,
 	SoupWebsocketDataType data_type, GBytes const * message) {
 
+	if (_recorder) {
+		gsize size = 0;
+		gchar const * data = (gchar const *)g_bytes_get_data((GBytes *)message, &size);
+		_recorder->record(traffic_direction::inbound, _connection_ids[connection],
+			(uint8_t)data_type, string_view{data, size});
+	}
+
 	switch (data_type) {
 		case SOUP_WEBSOCKET_DATA_BINARY: {
-			cout << "websocket: unknown binary message received, ignored\n";
+			gsize size = 0;
+			gchar * data = (gchar *)g_bytes_get_data((GBytes *)message, &size);
+			on_binary_message(connection, string_view{data, size});
 			return;
 		}
 
@@ -232,6 +739,19 @@ void server_channel::connection_handler(SoupWebsocketConnection * connection, ch
 	assert(_clients.count(connection) == 0);  // check connection is always unique
 	g_object_ref(G_OBJECT(connection));
 	_clients.insert(connection);
+	_connection_ids[connection] = _next_connection_id++;
+}
+
+void server_channel::send_snapshot(SoupWebsocketConnection * connection) {
+	if (!_snapshot || !is_open(connection))
+		return;
+
+	// each cached value is sent as its own text frame (in key order)
+	string buf;
+	_snapshot->for_each([connection, &buf](string_view, string_view value){
+		buf.assign(value.data(), value.size());  // we need zero terminated string there
+		soup_websocket_connection_send_text(connection, buf.c_str());
+	});
 }
 
 void server_channel::closed_handler(SoupWebsocketConnection * connection) {
@@ -240,8 +760,18 @@ void server_channel::closed_handler(SoupWebsocketConnection * connection) {
 
 	cout << "websocket: connection " << static_cast<void *>(*it) << " closed\n";
 
+	if (_delta)
+		for (auto & [key, stream] : _delta->streams)
+			stream.synced.erase(connection);
+
+	_lanes.erase(connection);
+	_connection_ids.erase(connection);
+
 	g_object_unref(G_OBJECT(*it));
 	_clients.erase(it);
+
+	if (_draining && _clients.empty())
+		drain_done();
 }
 
 
@@ -262,6 +792,10 @@ void server_channel::websocket_handler_cb(SoupServer * server, SoupWebsocketConn
 		G_CALLBACK(websocket_closed_handler_cb), channel);
 
 	channel->connection_handler(connection, path, client);
+	channel->send_snapshot(connection);
+
+	if (channel->draining())  // handshake finished after drain started
+		soup_websocket_connection_close(connection, SOUP_WEBSOCKET_CLOSE_GOING_AWAY, "server going away");
 }
 
 void server_channel::websocket_closed_handler_cb(SoupWebsocketConnection * connection,
@@ -280,6 +814,28 @@ void server_channel::websocket_message_handler_cb(SoupWebsocketConnection * conn
 	channel->message_handler(connection, data_type, message);
 }
 
+gboolean server_channel::drain_step_cb(gpointer user_data) {
+	server_channel * channel = static_cast<server_channel *>(user_data);
+	assert(channel);
+	if (channel->drain_step())
+		return G_SOURCE_CONTINUE;
+
+	detail::destroy_source(channel->_drain_step);
+	return G_SOURCE_REMOVE;
+}
+
+gboolean server_channel::drain_deadline_cb(gpointer user_data) {
+	server_channel * channel = static_cast<server_channel *>(user_data);
+	assert(channel);
+
+	cout << "websocket: drain deadline expired, " << size(channel->_clients) << " connection(s) left\n";
+	while (!channel->_clients.empty())
+		channel->drop_client(*begin(channel->_clients));
+
+	channel->drain_done();
+	return G_SOURCE_REMOVE;
+}
+
 
 namespace detail {
 
@@ -287,6 +843,51 @@ void on_close(SoupWebsocketConnection * conn, gpointer) {
 	soup_websocket_connection_close(conn, SOUP_WEBSOCKET_CLOSE_NORMAL, nullptr);
 }
 
+GSocket * reuse_port_socket(int port, GError ** error) {
+	// IPv6 socket accepts also IPv4 connections, IPv4 only socket is used as fallback
+	for (GSocketFamily family : {G_SOCKET_FAMILY_IPV6, G_SOCKET_FAMILY_IPV4}) {
+		g_clear_error(error);
+
+		GSocket * sock = g_socket_new(family, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, error);
+		if (!sock)
+			continue;
+
+		GInetAddress * any = g_inet_address_new_any(family);
+		GSocketAddress * addr = g_inet_socket_address_new(any, port);
+		g_object_unref(any);
+
+		bool const listening = g_socket_set_option(sock, SOL_SOCKET, SO_REUSEPORT, 1, error)
+			&& g_socket_bind(sock, addr, TRUE, error)
+			&& g_socket_listen(sock, error);
+
+		g_object_unref(addr);
+
+		if (listening)
+			return sock;
+
+		g_object_unref(sock);
+	}
+
+	return nullptr;
+}
+
+void attach_timeout(GSource *& source, milliseconds interval, GSourceFunc func, gpointer data) {
+	assert(!source);
+	source = g_timeout_source_new(interval.count());
+	g_source_set_priority(source, G_PRIORITY_LOW);
+	g_source_set_callback(source, func, data, nullptr);
+	g_source_attach(source, g_main_context_get_thread_default());
+}
+
+void destroy_source(GSource *& source) {
+	if (!source)
+		return;
+
+	g_source_destroy(source);
+	g_source_unref(source);
+	source = nullptr;
+}
+
 }  // detail
 
 }  // websocket
@@ -1,5 +1,8 @@
 #pragma once
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <map>
 #include <set>
 #include <string>
 #include <string_view>
@@ -7,9 +10,14 @@
 #include <system_error>
 #include <boost/noncopyable.hpp>
 #include <libsoup/soup.h>
+#include "priority_lanes.hpp"
+#include "unix_socket.hpp"
 
 namespace websocket {
 
+class traffic_recorder;
+class last_value_cache;
+
 /*! WebSocket (Secure) 1:1 client channel implementation.
 Implementation allows to connect to server WebSocket and send string messages.
 
@@ -39,15 +47,32 @@ public:
 	explicit client_channel(std::filesystem::path const & ssl_cert_file);  //!< Creates WebSocket Secure (WSS) channel.
 	~client_channel();
 	void connect(std::string const & address, connected_handler && handler);
+
+	/*! Connects channel over already established `stream` (no HTTP handshake), used for in-process
+	loopback transport (see connect_loopback()). Handler is called before function returns. */
+	void connect(GIOStream * stream, connected_handler && handler);
+
+	/*! Connects to server listening on Unix domain socket (see server_channel::listen_unix()).
+	\param[in] socket_path socket file path or abstract socket name prefixed with '@' (e.g. "@echo")
+	\param[in] path WebSocket resource path e.g. "/echo" */
+	void connect_unix(std::string const & socket_path, std::string const & path, connected_handler && handler);
+
 	void reconnect();
 	void send(std::string const & msg);
+	void send_binary(std::string_view msg);
+	void enable_priority_lanes();  //!< Enables reassembly of fragmented messages (see server_channel::enable_priority_lanes()).
+	void enable_delta();  //!< Enables delta mode, delta messages are reconstructed before on_message() call (see server_channel::enable_delta()).
 
 protected:
 	virtual void on_message(std::string_view msg) {}
+	virtual void on_binary_message(std::string_view msg);
+	virtual void on_closed() {}  //!< Called after connection is closed (by either side), not called from destructor.
 
 private:
 	void connection_handler(GAsyncResult * res);
+	void connection_established();
 	void message_handler(SoupWebsocketDataType data_type, GBytes const * message);
+	void delta_message_handler(std::string_view msg);
 	void closed_handler();
 
 	// libsoup callback handlers
@@ -57,24 +82,114 @@ private:
 
 	SoupSession * _sess;
 	SoupWebsocketConnection * _conn;
+	GCancellable * _unix_connect;  //!< pending Unix socket connection or nullptr
 	std::string _address;
 	connected_handler _connected_handler;
+	bool _delta;  //!< delta mode enabled
+	std::map<std::string, std::string, std::less<>> _baselines;  //!< last reconstructed message of each synced (keyframe received) delta stream
+	std::string _reconstructed;
+	std::unique_ptr<detail::lane_reassembler> _lanes;  //!< nullptr if priority lanes are not enabled
 };
 
 /*! WebSocket (Secure) 1:N server channel implementation for communication with a group of clients.
-\note To create secure channel use server_channel(ssl_cert_file, ssl_key_file) constructor. */
+\note To create secure channel use server_channel(ssl_cert_file, ssl_key_file) constructor.
+
+Late joining clients can receive the last broadcasted value of each key (snapshot) right
+after they are connected, this way
+
+\code
+server_channel ch;
+ch.enable_snapshot(1 << 20);  // keep up to 1MiB of last values
+ch.listen(4651, "/feed");
+ch.send_all("EURUSD", R"({"bid":1.0712,"ask":1.0714})");
+\endcode
+
+For zero-downtime restart listen with `reuse_port` enabled (new process can bind the same port
+while the old one is still running) and drain old server before quit, this way
+
+\code
+loop.set_interrupt_handler([&]{
+	ch.drain(5s, [&loop]{loop.quit();});
+});
+\endcode */
 class server_channel : private boost::noncopyable {
 public:
+	using drained_handler = std::function<void ()>;
+
 	server_channel();  //!< Creates plain WebSocket channel.
 	server_channel(std::filesystem::path const & ssl_cert_file, std::filesystem::path const & ssl_key_file);  //!< Creates WebSocket Secure (WSS) server channel.
 	~server_channel();
-	bool listen(int port, std::string const & path);  //!< param[in] path e.g. "/echo"
+
+	/*! \param[in] path e.g. "/echo"
+	\param[in] reuse_port listen with SO_REUSEPORT socket option so more server instances can listen on the same port */
+	bool listen(int port, std::string const & path, bool reuse_port = false);
+
+	/*! Accepts client connection over already established `stream` (no HTTP handshake), used for
+	in-process loopback transport (see connect_loopback()). */
+	void accept(GIOStream * stream);
+
+	/*! Listen on Unix domain socket (for local clients). Stale socket file is replaced, socket
+	file is removed when channel is destroyed.
+	\param[in] socket_path socket file path or abstract socket name prefixed with '@' (e.g. "@echo")
+	\param[in] path e.g. "/echo" */
+	bool listen_unix(std::string const & socket_path, std::string const & path);
+
 	void send_all(std::string const & msg);
+	void send_all_binary(std::string_view msg);
+
+	//! Broadcasts message in `prio` priority lane (see enable_priority_lanes()), equivalent to send_all(msg) if lanes are not enabled.
+	void send_all(std::string const & msg, priority prio);
+
+	/*! Enables outbound priority lanes. Each client gets its own control, normal and bulk queue,
+	messages are passed to libsoup one by one (highest priority first) only when client's send
+	queue is flushed and large messages are split into fragments, so control message can be sent
+	between fragments of large bulk message (clients needs to enable priority lanes with
+	client_channel::enable_priority_lanes()).
+	\param[in] fragment_size maximal fragment size
+	\note send_all() without priority uses normal lane, delta mode takes precedence over priority lanes */
+	void enable_priority_lanes(size_t fragment_size = 16*1024);
+
+	/*! Gracefully drains channel, it stops accepting new connections, closes clients with
+	"going away" close code (after their send queue is flushed) and waits for clients to close.
+	\param[in] deadline remaining connections are dropped after deadline
+	\param[in] handler called when all clients are closed or deadline expires */
+	void drain(std::chrono::milliseconds deadline, drained_handler && handler);
+	bool draining() const;
+
+	/*! Broadcasts message and keeps it as the last value of `key` for late joining clients (see enable_snapshot()).
+	In delta mode each `key` is a separate delta stream (see enable_delta()). */
+	void send_all(std::string const & key, std::string const & msg);
+
+	/*! Enables last value cache, cached values are sent to each new client right after it is connected
+	(each value as a separate text message, in key order).
+	\param[in] max_bytes maximum size of cached keys and values, least recently updated keys are evicted first */
+	void enable_snapshot(size_t max_bytes);
+
+	/*! Enables delta mode, broadcasted messages are sent as binary deltas against the previously
+	broadcasted message of the same stream (clients needs to enable delta mode with
+	client_channel::enable_delta()). Each send_all(key, msg) key is a separate stream, send_all(msg)
+	uses default stream. Messages with keys longer than 255 bytes are sent as plain text messages.
+	\param[in] keyframe_interval full message (keyframe) is sent to all clients after each `keyframe_interval` messages */
+	void enable_delta(size_t keyframe_interval = 100);
+
+	/*! Records received and broadcasted messages into traffic log.
+	\param[in] recorder recorder or nullptr to stop recording, channel doesn't take ownership
+	\see traffic_recorder */
+	void set_recorder(traffic_recorder * recorder);
 
 protected:
 	virtual void on_message(std::string_view msg);
+	virtual void on_binary_message(std::string_view msg);
+
+	//! Called for received binary message with the sending `connection`, calls on_binary_message(msg) by default.
+	virtual void on_binary_message(SoupWebsocketConnection * connection, std::string_view msg);
+
+	//! Sends binary message to `connection` only (e.g. response to a request).
+	void send_binary(SoupWebsocketConnection * connection, std::string_view msg);
 
 private:
+	bool create_server(std::string const & path, SoupServerListenOptions & options);
+
 	void message_handler(SoupWebsocketConnection * connection,
 		SoupWebsocketDataType data_type, GBytes const * message);
 
@@ -82,6 +197,13 @@ private:
 		SoupClientContext * client);
 
 	void closed_handler(SoupWebsocketConnection * connection);
+	void send_snapshot(SoupWebsocketConnection * connection);
+	void send_all_text(std::string const & msg);  //!< plain text broadcast (lanes aware), no delta encoding
+	void send_all_delta(std::string_view key, std::string const & msg);
+	void send_all_lanes(std::string_view msg, SoupWebsocketDataType type, priority prio);
+	bool drain_step();  //!< \return true if there are still clients to be closed
+	void drain_done();
+	void drop_client(SoupWebsocketConnection * connection);
 
 	// libsoup handlers
 	static void websocket_handler_cb(SoupServer * server, SoupWebsocketConnection * connection,
@@ -93,9 +215,42 @@ private:
 	static void websocket_message_handler_cb(SoupWebsocketConnection * connection,
 		SoupWebsocketDataType data_type, GBytes * message, gpointer user_data);
 
+	// drain timer handlers
+	static gboolean drain_step_cb(gpointer user_data);
+	static gboolean drain_deadline_cb(gpointer user_data);
+
 	GTlsCertificate * _cert;  //!< SSL certificate in case of secure connection
 	SoupServer * _server;
+	detail::unix_socket_file _socket_file;  //!< removed when channel is destroyed
 	std::set<SoupWebsocketConnection *> _clients;
+	traffic_recorder * _recorder;
+	std::map<SoupWebsocketConnection *, uint64_t> _connection_ids;  //!< recorded connection identifiers (addresses are reused)
+	uint64_t _next_connection_id;
+	std::unique_ptr<last_value_cache> _snapshot;  //!< last value cache, nullptr if snapshot is not enabled
+
+	//! Delta mode broadcast stream state.
+	struct delta_stream {
+		size_t since_keyframe;  //!< number of messages sent since the last keyframe
+		std::string baseline;  //!< last broadcasted message
+		std::set<SoupWebsocketConnection *> synced;  //!< clients with up to date baseline
+	};
+
+	struct delta_mode {
+		size_t keyframe_interval;
+		std::map<std::string, delta_stream, std::less<>> streams;  //!< by send_all() key, "" for default stream
+		std::string keyframe;  //!< reusable frame buffers
+		std::string delta;
+	};
+
+	std::unique_ptr<delta_mode> _delta;  //!< nullptr if delta mode is not enabled
+
+	size_t _lanes_fragment_size;  //!< 0 if priority lanes are not enabled
+	std::map<SoupWebsocketConnection *, std::unique_ptr<detail::outbound_lanes>> _lanes;
+
+	bool _draining;
+	GSource * _drain_step;  //!< drain timers, nullptr if not active
+	GSource * _drain_deadline;
+	drained_handler _drained_handler;
 };
 
 }  // websocket
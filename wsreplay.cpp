@@ -0,0 +1,99 @@
+/* WebSocket traffic replay tool, replays recorded client (inbound) messages from a traffic
+log through client_channel instances (one per recorded connection).
+
+usage: wsreplay LOG ADDRESS [SPEED]
+
+where SPEED is replay speed factor (e.g. 2 for twice as fast as recorded, 0 for as fast
+as possible), 1 by default. */
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include "websocket.hpp"
+#include "traffic_recorder.hpp"
+#include "glib_event_loop.hpp"
+
+using std::map, std::unique_ptr, std::make_unique, std::string, std::vector;
+using std::chrono::steady_clock, std::chrono::nanoseconds, std::chrono::milliseconds,
+	std::chrono::duration, std::chrono::duration_cast;
+using std::cout, std::endl;
+using namespace std::chrono_literals;
+
+using websocket::client_channel, websocket::traffic_log, websocket::traffic_record,
+	websocket::traffic_direction;
+
+int main(int argc, char * argv[]) {
+	if (argc < 3) {
+		cout << "usage: wsreplay LOG ADDRESS [SPEED]\n";
+		return 1;
+	}
+
+	double const speed = argc > 3 ? std::stod(argv[3]) : 1.0;
+
+	traffic_log log{argv[1]};
+	if (!log.is_open())
+		return 1;
+
+	glib_event_loop loop;
+
+	// one channel per recorded client connection
+	map<uint64_t, unique_ptr<client_channel>> channels;
+	vector<traffic_record> records;
+	for (traffic_record rec; log.next(rec);) {
+		if (rec.direction != traffic_direction::inbound)
+			continue;
+
+		records.push_back(rec);
+		if (channels.count(rec.connection) == 0)
+			channels[rec.connection] = make_unique<client_channel>();
+	}
+
+	size_t connected = 0;
+	for (auto & [id, ch] : channels)
+		ch->connect(argv[2], [&connected](std::error_code const & ec){++connected;});
+
+	cout << "connecting " << size(channels) << " client(s) to " << argv[2] << " ..." << endl;
+
+	loop.go_while([&]{return connected < size(channels);}, 5s);
+	if (connected < size(channels)) {
+		cout << "wsreplay: unable to connect all clients\n";
+		return 1;
+	}
+
+	// replay
+	auto const start = steady_clock::now();
+	nanoseconds const first = empty(records) ? 0ns : records.front().timestamp;
+	size_t bytes = 0;
+
+	for (traffic_record const & rec : records) {
+		if (speed > 0) {
+			auto const due = start + duration_cast<nanoseconds>(
+				duration<double, std::nano>{(rec.timestamp - first).count() / speed});
+
+			while (steady_clock::now() < due) {
+				loop.loop_iteration();
+				std::this_thread::sleep_for(std::min(duration_cast<nanoseconds>(due - steady_clock::now()),
+					nanoseconds{milliseconds{1}}));
+			}
+		}
+		else
+			loop.loop_iteration();
+
+		if (rec.type == SOUP_WEBSOCKET_DATA_TEXT)
+			channels[rec.connection]->send(string{rec.payload});
+		else
+			channels[rec.connection]->send_binary(rec.payload);
+		bytes += size(rec.payload);
+	}
+
+	double const elapsed = duration<double>{steady_clock::now() - start}.count();
+	cout << "replayed " << size(records) << " messages (" << bytes << " bytes) in "
+		<< elapsed << "s, " << (elapsed > 0 ? size(records) / elapsed : 0) << " msg/s" << endl;
+
+	loop.go_for(500ms);  // flush send queues
+	return 0;
+}